@@ -1,25 +1,78 @@
 #include "app.hpp"
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <unordered_set>
 #include "ui/imfilebrowser.h"
+#include "ui/journal.hpp"
+
+
+namespace {
+  // Transitions being dragged out or reconnected point at TEMP placeholder states
+  // and are not part of the saved model.
+  bool isTemporary(const core::Transition &tr) {
+    return tr.from().isTemporary() || tr.to().isTemporary();
+  }
+
+  const float MinZoom = 0.02f;
+  const float MaxZoom = 4.0f;
+  const float OverviewZoom = 0.4f;
+  const float MinTextPixels = 6.0f;
+
+  // States draw a little past their circle (start arrow, long names).
+  const float StateCullMargin = 64.0f;
+
+  // Culling tests. Labels are placed off their transition's control points, so they are
+  // drawn whenever their transition is rather than tested by their own rect.
+  bool isInView(const ui::StateDrawObject &obj, const utils::Rect &view) {
+    const utils::Rect rc{ view.x - StateCullMargin, view.y - StateCullMargin,
+      view.w + StateCullMargin * 2, view.h + StateCullMargin * 2 };
+    return rc.intersects(obj.boundingRect());
+  }
+
+  bool isInView(const ui::TransitionDrawObject &obj, const utils::Rect &view) {
+    return view.intersects(obj.boundingRect());
+  }
+
+  template <class T>
+  void drawWithManipulator(const T &obj, ImDrawList *dr) {
+    obj.draw(dr);
+    if (auto p = obj.getManipulator()) {
+      p->draw(dr);
+    }
+  }
+}
 
 
 
 AppState::AppState() : labelEditor_(*this), stateEditor_(*this), selectionObj_(this)
 {
+  listenToExecutor();
 }
 
 void AppState::reset()
 {
   tm_ = {};
+  const auto budget = executor_.budget();
+  const auto token = executor_.cancellationToken();
   executor_ = {};
+  executor_.setBudget(budget);
+  executor_.setCancellationToken(token);
+  listenToExecutor();
   menu_ = Menu::SELECT;
   stateToPosition_.clear();
-  drawObjects_.clear();
+  layoutVersion_++;
+  clearDrawObjects();
   selectionObj_.reset();
   windowTitle_ = "Turing Machine GUI";
   scrollXY_ = ImVec2{ 0, 0 };
+  viewport_ = {};
+  zoom_ = 1.0f;
+  canvasExtent_ = {};
   dragState = {};
   tempAddState_ = {};
+  unplacedStates_.clear();
 }
 
 void AppState::setMenu(AppState::Menu m)
@@ -35,96 +88,224 @@ ImVec2 AppState::statePosition(const core::State &state) const
 void AppState::removeStatePosition(const core::State &state)
 {
   stateToPosition_.erase(state);
+  layoutVersion_++;
 }
 
 void AppState::setStatePosition(const core::State &state, ImVec2 pos)
 {
-  stateToPosition_[state] = screenToCanvas(pos);
+  const ImVec2 canvasPos = screenToCanvas(pos);
+  storeStatePosition(state, canvasPos);
+  if (journal_ && !state.isTemporary()) journal_->moveState(state, canvasPos);
+}
+
+void AppState::storeStatePosition(const core::State &state, ImVec2 canvasPos)
+{
+  stateToPosition_[state] = canvasPos;
+  layoutVersion_++;
+  canvasExtent_ = ImVec2((std::max)(canvasExtent_.x, canvasPos.x), (std::max)(canvasExtent_.y, canvasPos.y));
+  indexState(state);
+}
+
+void AppState::placeStates(const std::vector<core::State> &states, const std::vector<ImVec2> &canvasPos, bool record)
+{
+  for (size_t i = 0; i < states.size() && i < canvasPos.size(); i++) {
+    if (!stateObjects_.count(states[i])) continue;
+    storeStatePosition(states[i], canvasPos[i]);
+    if (record && journal_ && !states[i].isTemporary()) journal_->moveState(states[i], canvasPos[i]);
+  }
+}
+
+void AppState::indexState(const core::State &state)
+{
+  auto it = stateObjects_.find(state);
+  if (it == stateObjects_.end()) return;
+  const float r = ui::StateDrawObject::radius();
+  const ImVec2 c = stateToPosition_.at(state);
+  spatialIndex_.update(it->second->indexHandle(), utils::Rect{ c.x - r, c.y - r, r * 2, r * 2 });
 }
 
 void AppState::addState(const core::State &state, ImVec2 pos)
 {
   tm_.addUnconnectedState(state);
-  stateToPosition_[state] = screenToCanvas(pos);
-  drawObjects_.emplace_back(std::make_unique<ui::StateDrawObject>(state, this));
+  storeStatePosition(state, screenToCanvas(pos));
+  createStateObject(state);
+  if (journal_ && !state.isTemporary()) journal_->addState(state, stateToPosition_[state]);
 }
 
 ui::TransitionDrawObject *AppState::addTransition(const core::Transition &trans)
 {
-  tm_.addTransition(trans);
-  return createTransitionObject(trans);
+  const auto &stored = tm_.addTransition(trans);
+  if (journal_ && !isTemporary(trans)) journal_->addTransition(trans);
+  return createTransitionObject(stored);
+}
+
+ui::StateDrawObject *AppState::createStateObject(const core::State &state)
+{
+  auto *st = statePool_.create(state, this);
+  st->setIndexHandle(spatialIndex_.add(st));
+  stateObjects_[state] = st;
+  indexState(state);
+  return st;
 }
 
 ui::TransitionDrawObject *AppState::createTransitionObject(const core::Transition &trans)
 {
-  auto transObj = std::make_unique<ui::TransitionDrawObject>(trans, this);
-  auto *tr = transObj.get();
-  drawObjects_.push_back(std::move(transObj));
-  auto lb = std::make_unique<ui::TransitionLabelDrawObject>(tr, this);
-  tr->addLabel(lb.get());
-  drawObjects_.push_back(std::move(lb));
+  auto *tr = transitionPool_.create(trans, this);
+  tr->setIndexHandle(spatialIndex_.add(tr));
+  auto *lb = labelPool_.create(tr, this);
+  tr->addLabel(lb);
+  lb->setIndexHandle(spatialIndex_.add(lb));
   return tr;
 }
 
+void AppState::addStates(const std::vector<core::State> &states, const std::vector<ImVec2> &positions)
+{
+  tm_.addUnconnectedStates(states);
+  for (size_t i = 0; i < states.size(); i++) {
+    storeStatePosition(states[i], screenToCanvas(positions.at(i)));
+    createStateObject(states[i]);
+    if (journal_ && !states[i].isTemporary()) journal_->addState(states[i], stateToPosition_[states[i]]);
+  }
+}
+
+void AppState::addTransitions(const std::vector<core::Transition> &transitions)
+{
+  tm_.addTransitions(transitions);
+  const auto &stored = tm_.transitions();
+  for (size_t i = stored.size() - transitions.size(); i < stored.size(); i++) {
+    if (journal_ && !isTemporary(stored[i])) journal_->addTransition(stored[i]);
+    createTransitionObject(stored[i]);
+  }
+}
+
+void AppState::destroyDrawObjects(const std::vector<ui::TransitionDrawObject *> &transitions, const std::vector<ui::StateDrawObject *> &states)
+{
+  std::vector<const ui::DrawObject *> gone;
+  gone.reserve(transitions.size() * 2 + states.size());
+  for (auto *tr : transitions) {
+    gone.insert(gone.end(), tr->getLabels().begin(), tr->getLabels().end());
+    gone.push_back(tr);
+  }
+  gone.insert(gone.end(), states.begin(), states.end());
+  for (auto *obj : gone) {
+    spatialIndex_.remove(obj);
+  }
+  std::sort(gone.begin(), gone.end());
+  std::erase_if(drawnEdges_, [&](const ui::DrawObject *obj) { return std::binary_search(gone.begin(), gone.end(), obj); });
+  for (auto *tr : transitions) {
+    for (auto *label : tr->getLabels()) {
+      labelPool_.destroy(label);
+    }
+    transitionPool_.destroy(tr);
+  }
+  for (auto *st : states) {
+    stateObjects_.erase(st->getState());
+    statePool_.destroy(st);
+  }
+}
+
 void AppState::removeState(const core::State &state)
 {
-  tm_.removeState(state);
-  removeStatePosition(state);
-  drawObjects_.erase(std::remove_if(drawObjects_.begin(), drawObjects_.end(),
-    [&](const std::unique_ptr<ui::DrawObject> &obj) {
-      if (auto stateObj = obj->asState()) {
-        return stateObj->getState() == state;
-      }
-      if (auto transObj = obj->asTransition()) {
-        const auto &trans = transObj->getTransition();
-        return trans.from() == state || trans.to() == state;
-      }
-      return false;
-    }), drawObjects_.end());
+  removeStates({ state });
+}
+
+void AppState::removeStates(const std::vector<core::State> &states)
+{
+  tm_.removeStates(states);
+  std::unordered_set<std::string> names;
+  names.reserve(states.size());
+  std::vector<ui::StateDrawObject *> stateObjs;
+  for (const auto &state : states) {
+    if (journal_ && !state.isTemporary()) journal_->removeState(state);
+    removeStatePosition(state);
+    names.insert(state.name());
+    if (auto it = stateObjects_.find(state); it != stateObjects_.end()) {
+      stateObjs.push_back(it->second);
+    }
+  }
+  std::vector<ui::TransitionDrawObject *> attached;
+  transitionPool_.forEach([&](ui::TransitionDrawObject &tr) {
+    const auto &trans = tr.getTransition();
+    if (names.contains(trans.from().name()) || names.contains(trans.to().name())) attached.push_back(&tr);
+  });
+  destroyDrawObjects(attached, stateObjs);
 }
 
 void AppState::updateState(const core::State &old, const core::State &with)
 {
   auto what{ old };
   tm_.updateState(what, with);
-  for (auto &obj : drawObjects_) {
-    if (auto t = obj->asTransition()) {
-      if (t->getTransition().from() == what) {
-        t->getTransition().setFrom(with);
-      }
-      if (t->getTransition().to() == what) {
-        t->getTransition().setTo(with);
-      }
-    } else if (auto t = obj->asState()) {
-      if (t->getState() == what) {
-        t->getState() = with;
-      }
+  if (journal_) journal_->updateState(what, with);
+  auto &bps = executor_.breakpoints();
+  if (what.name() != with.name() && bps.hasState(what.name())) {
+    bps.setState(what.name(), false);
+    bps.setState(with.name(), true);
+  }
+  transitionPool_.forEach([&](ui::TransitionDrawObject &t) {
+    if (t.getTransition().from() == what) {
+      t.getTransition().setFrom(with);
+    }
+    if (t.getTransition().to() == what) {
+      t.getTransition().setTo(with);
     }
+  });
+  if (auto node = stateObjects_.extract(what)) {
+    node.mapped()->getState() = with;
+    node.key() = with;
+    stateObjects_.insert(std::move(node));
   }
   auto xy = statePosition(what);
   removeStatePosition(what);
   setStatePosition(with, xy);
 }
 
+void AppState::updateTransition(const core::Transition &what, const core::Transition &with)
+{
+  const bool known = tm_.hasTransition(what);
+  tm_.updateTransition(what, with);
+  if (journal_ && known && !isTemporary(with)) {
+    // Completing a drag turns a placeholder transition into a real one.
+    if (isTemporary(what)) journal_->addTransition(with);
+    else journal_->updateTransition(what, with);
+  }
+}
+
+void AppState::writeTapeCell(int index, char symbol)
+{
+  tm_.tape().writeAt(index, symbol);
+  if (journal_) journal_->writeTape(index, symbol);
+}
+
+std::optional<char> AppState::internSymbol(const std::string &name)
+{
+  auto &symbols = tm_.symbols();
+  if (auto code = symbols.find(name)) return code;
+  auto code = symbols.intern(name);
+  if (!code) {
+    std::cerr << "No symbol codes left for '" << name << "'" << std::endl;
+    return std::nullopt;
+  }
+  if (journal_) journal_->addSymbol(name, *code);
+  return code;
+}
+
 void AppState::removeTransition(const core::Transition &trans)
 {
-  tm_.removeTransition(trans);
-  std::vector<ui::DrawObject *> toRemove;
-  for (auto &obj : drawObjects_) {
-    if (auto t = obj->asTransition()) {
-      if (t->getTransition() == trans) {
-        for (auto *label : t->getLabels()) {
-          toRemove.push_back(label);
-        }
-        toRemove.push_back(t);
-        break;
-      }
-    }
+  removeTransitions({ trans });
+}
+
+void AppState::removeTransitions(const std::vector<core::Transition> &transitions)
+{
+  auto removed = tm_.removeTransitions(transitions);
+  for (const auto &trans : transitions) {
+    if (journal_ && !isTemporary(trans)) journal_->removeTransition(trans);
   }
-  drawObjects_.erase(std::remove_if(drawObjects_.begin(), drawObjects_.end(),
-    [&](const std::unique_ptr<ui::DrawObject> &obj) {
-      return std::find(toRemove.begin(), toRemove.end(), obj.get()) != toRemove.end();
-    }), drawObjects_.end());
+  const std::unordered_set<uint32_t> ids(removed.begin(), removed.end());
+  std::vector<ui::TransitionDrawObject *> gone;
+  transitionPool_.forEach([&](ui::TransitionDrawObject &tr) {
+    if (ids.contains(tr.getTransition().id())) gone.push_back(&tr);
+  });
+  destroyDrawObjects(gone, {});
 }
 
 void AppState::setCanvasOrigin(const ImVec2 &o)
@@ -132,48 +313,111 @@ void AppState::setCanvasOrigin(const ImVec2 &o)
   canvasOrigin_ = o;
 }
 
+void AppState::zoomAt(float zoom, const ImVec2 &anchor)
+{
+  const ImVec2 c = screenToCanvas(anchor);
+  zoom_ = std::clamp(zoom, MinZoom, MaxZoom);
+  // Solve canvasToScreen(c) == anchor for the scroll offset; scrolling cannot go negative.
+  scrollXY_ = ImVec2((std::max)(0.0f, c.x * zoom_ - (anchor.x - canvasOrigin_.x)),
+    (std::max)(0.0f, c.y * zoom_ - (anchor.y - canvasOrigin_.y)));
+}
+
+bool AppState::isOverview() const
+{
+  return zoom_ < OverviewZoom;
+}
+
+bool AppState::showsText() const
+{
+  return !isOverview() && ImGui::GetFontSize() * zoom_ >= MinTextPixels;
+}
+
 ImVec2 AppState::screenToCanvas(const ImVec2 &p) const
 {
-  return ImVec2(p.x - canvasOrigin_.x + scrollXY_.x, p.y - canvasOrigin_.y + scrollXY_.y);
+  return ImVec2((p.x - canvasOrigin_.x + scrollXY_.x) / zoom_, (p.y - canvasOrigin_.y + scrollXY_.y) / zoom_);
 }
 
 ImVec2 AppState::canvasToScreen(const ImVec2 &p) const
 {
-  return ImVec2(canvasOrigin_.x - scrollXY_.x + p.x, canvasOrigin_.y - scrollXY_.y + p.y);
+  return ImVec2(canvasOrigin_.x - scrollXY_.x + p.x * zoom_, canvasOrigin_.y - scrollXY_.y + p.y * zoom_);
 }
 
 utils::Rect AppState::canvasToScreen(const utils::Rect &p) const
 {
   auto t = canvasToScreen(ImVec2{ p.x, p.y });
-  return { t.x, t.y, p.w, p.h };
+  return { t.x, t.y, p.w * zoom_, p.h * zoom_ };
+}
+
+utils::Rect AppState::screenToCanvas(const utils::Rect &p) const
+{
+  auto t = screenToCanvas(ImVec2{ p.x, p.y });
+  return { t.x, t.y, p.w / zoom_, p.h / zoom_ };
 }
 
 ui::DrawObject *AppState::targetObject(const ImVec2 &pos) const
 {
   if (hasOpenPopup()) return nullptr;
+  const ImVec2 p = screenToCanvas(pos);
+  std::vector<ui::DrawObject *> candidates;
+  spatialIndex_.queryPoint(p.x, p.y, candidates);
   ui::DrawObject *other = nullptr;
-  ui::DrawObject *transitionHit = nullptr;
-  for (auto &obj : drawObjects_) {
+  for (auto *obj : candidates) {
     if (obj->containsPoint(pos.x, pos.y)) {
       if (obj->asTransition()) {
-        transitionHit = obj.get();
-        break; // First transition wins
+        return obj; // First transition wins
       } else if (!other) {
-        other = obj.get();
+        other = obj;
       }
     }
   }
-  return transitionHit ? transitionHit : other;
+  return other;
+}
+
+void AppState::queryObjects(const utils::Rect &rc, std::vector<ui::DrawObject *> &out) const
+{
+  spatialIndex_.queryRect(screenToCanvas(rc), out);
+}
+
+void AppState::updateSpatialIndex(const ui::DrawObject *obj, const utils::Rect *boxes, size_t n)
+{
+  auto h = obj->indexHandle();
+  if (!h) return;
+  utils::Rect canvasBoxes[MaxHitBoxes];
+  n = (std::min)(n, MaxHitBoxes);
+  for (size_t i = 0; i < n; i++) {
+    canvasBoxes[i] = screenToCanvas(boxes[i]);
+  }
+  spatialIndex_.update(h, canvasBoxes, n);
 }
 
 void AppState::drawObjects(ImDrawList *dr)
 {
-  for (auto &obj : drawObjects_) {
-    obj->draw(dr);
-    if (auto p = obj->getManipulator()) {
-      p->draw(dr);
+  const bool cull = viewport_.w > 0 && viewport_.h > 0;
+  std::vector<ui::DrawObject *> drawnEdges;
+  std::vector<ui::TransitionLabelDrawObject *> labels;
+  transitionPool_.forEach([&](ui::TransitionDrawObject &tr) {
+    if (cull && !isInView(tr, viewport_)) return;
+    drawnEdges.push_back(&tr);
+    drawWithManipulator(tr, dr);
+    labels.insert(labels.end(), tr.getLabels().begin(), tr.getLabels().end());
+  });
+  statePool_.forEach([&](const ui::StateDrawObject &st) {
+    if (cull && !isInView(st, viewport_)) return;
+    drawWithManipulator(st, dr);
+  });
+  for (auto *label : labels) {
+    drawnEdges.push_back(label);
+    drawWithManipulator(*label, dr);
+  }
+  // Transitions and labels that went off-screen drop their hit areas; their geometry
+  // is only current while they are drawn.
+  std::sort(drawnEdges.begin(), drawnEdges.end());
+  for (auto *obj : drawnEdges_) {
+    if (!std::binary_search(drawnEdges.begin(), drawnEdges.end(), obj)) {
+      spatialIndex_.update(obj->indexHandle(), nullptr, 0);
     }
   }
+  drawnEdges_.swap(drawnEdges);
   selectionObj_.draw(dr);
   transitionLabelEditor().render();
   stateEditor().render();
@@ -181,44 +425,41 @@ void AppState::drawObjects(ImDrawList *dr)
 
 void AppState::clearDrawObjects()
 {
-  drawObjects_.clear();
+  transitionPool_.clear();
+  labelPool_.clear();
+  statePool_.clear();
+  spatialIndex_.clear();
+  stateObjects_.clear();
+  drawnEdges_.clear();
 }
 
 void AppState::clearManipulators()
 {
-  for (auto &obj : drawObjects_) {
-    obj->removeManipulator();
-  }
+  forEachDrawObject([](auto &obj) { obj.removeManipulator(); });
 }
 
 void AppState::removeSelected()
 {
   std::vector<core::State> statesToRemove;
   std::vector<core::Transition> transToRemove;
-  for (auto &obj : drawObjects_) {
-    if (obj->getManipulator()) {
-      if (auto st = obj->asState())
-        statesToRemove.push_back(st->getState());
-      else if (auto tr = obj->asTransition())
-        transToRemove.push_back(tr->getTransition());
-    }
-  }
-  for (const auto &tr : transToRemove) {
-    removeTransition(tr);
-  }
-  for (const auto &st : statesToRemove) {
-    removeState(st);
-  }
+  statePool_.forEach([&](const ui::StateDrawObject &st) {
+    if (st.isSelected()) statesToRemove.push_back(st.getState());
+  });
+  transitionPool_.forEach([&](const ui::TransitionDrawObject &tr) {
+    if (tr.isSelected()) transToRemove.push_back(tr.getTransition());
+  });
+  removeTransitions(transToRemove);
+  removeStates(statesToRemove);
 }
 
 std::vector<ui::Manipulator *> AppState::getManipulators() const
 {
   std::vector<ui::Manipulator *> mans;
-  for (auto &obj : drawObjects_) {
-    if (auto p = obj->getManipulator()) {
+  forEachDrawObject([&](const auto &obj) {
+    if (auto p = obj.getManipulator()) {
       mans.push_back(p);
     }
-  }
+  });
   //if (auto p = selectionObj_.getManipulator())
   //  mans.push_back(p);
   return mans;
@@ -259,6 +500,18 @@ ImGui::FileBrowser &AppState::fileBrowserOpen()
   return t;
 }
 
+ImGui::FileBrowser &AppState::fileBrowserTapeImport()
+{
+  static ImGui::FileBrowser t;
+  return t;
+}
+
+ImGui::FileBrowser &AppState::fileBrowserTapeExport()
+{
+  static ImGui::FileBrowser t{ ImGuiFileBrowserFlags_EnterNewFilename };
+  return t;
+}
+
 void AppState::registerPopupName(const std::string &s)
 {
   popupNames_.insert(s);
@@ -275,31 +528,53 @@ bool AppState::hasOpenPopup() const
 void AppState::rebuildDrawObjectsFromTM()
 {
   // Clear existing draw objects without affecting TM
-  drawObjects_.clear();
+  clearDrawObjects();
   clearManipulators();
 
   // Create DrawObjects for existing states (don't add to TM again)
+  unplacedStates_.clear();
   for (const auto &state : tm_.states()) {
-    drawObjects_.emplace_back(std::make_unique<ui::StateDrawObject>(state, this));
-
-    // Set default position if not in position map
     if (stateToPosition_.find(state) == stateToPosition_.end()) {
-      stateToPosition_[state] = screenToCanvas(ImVec2(100, 100));
+      unplacedStates_.push_back(state);
     }
   }
+  // States without a position go on a grid below everything else until they are laid out.
+  const int columns = static_cast<int>(std::ceil(std::sqrt(double(unplacedStates_.size()))));
+  const float top = stateToPosition_.empty() ? 100.0f : canvasExtent_.y + 150.0f;
+  for (size_t i = 0; i < unplacedStates_.size(); i++) {
+    storeStatePosition(unplacedStates_[i], ImVec2(100.0f + (i % columns) * 150.0f, top + (i / columns) * 150.0f));
+  }
+  for (const auto &state : tm_.states()) {
+    createStateObject(state);
+  }
 
   // Create DrawObjects for existing transitions
   for (const auto &transition : tm_.transitions()) {
-    //drawObjects_.emplace_back(std::make_unique<ui::TransitionDrawObject>(transition, this));
     createTransitionObject(transition);
   }
 }
 
+void AppState::listenToExecutor()
+{
+  executor_.setStepListener([this](const core::StepEvent &e) { spaceTime_.record(e); });
+}
+
 void AppState::startExecution()
 {
+  if (!isExecuting()) {
+    spaceTime_.reset(tm_.tape());
+  }
   executor_.start(tm_);
 }
 
+void AppState::runToBreakpoint()
+{
+  if (!isExecuting()) {
+    spaceTime_.reset(tm_.tape());
+  }
+  executor_.runToBreakpoint(tm_);
+}
+
 void AppState::pauseExecution()
 {
   executor_.pause();
@@ -307,6 +582,9 @@ void AppState::pauseExecution()
 
 void AppState::stepExecution()
 {
+  if (!isExecuting()) {
+    spaceTime_.reset(tm_.tape());
+  }
   executor_.stepOnce(tm_);
 }
 
@@ -321,9 +599,34 @@ void AppState::updateExecution()
   if (executor_.isRunning()) {
     //highlightCurrentState();
     //highlightLastTransition();
+    frameScheduler_.requestFrameAt(*executor_.nextStepTime());
+    // The current state pulses while running.
+    frameScheduler_.requestFrameIn(std::chrono::milliseconds(33));
   }
 }
 
+void AppState::toggleSelectedBreakpoints()
+{
+  auto &bps = executor_.breakpoints();
+  std::vector<std::string> states;
+  std::vector<uint32_t> transitions;
+  bool all = true;
+  statePool_.forEach([&](const ui::StateDrawObject &st) {
+    if (!st.isSelected()) return;
+    states.push_back(st.getState().name());
+    all = all && bps.hasState(states.back());
+  });
+  transitionPool_.forEach([&](const ui::TransitionDrawObject &tr) {
+    if (!tr.isSelected()) return;
+    if (auto stored = tm_.findTransition(tr.getTransition())) {
+      transitions.push_back(stored->id());
+      all = all && bps.hasTransition(stored->id());
+    }
+  });
+  for (const auto &name : states) bps.setState(name, !all);
+  for (uint32_t id : transitions) bps.setTransition(id, !all);
+}
+
 core::ExecutionState AppState::getExecutionState() const
 {
   return executor_.state();
@@ -335,6 +638,8 @@ bool AppState::isExecuting() const
   case core::ExecutionState::RUNNING:
   case core::ExecutionState::PAUSED:
   case core::ExecutionState::STEP_MODE:
+  case core::ExecutionState::BUDGET_EXCEEDED:
+  case core::ExecutionState::CANCELLED:
     return true;
   default:
     return false;
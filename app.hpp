@@ -5,18 +5,26 @@
 #include "model/turingmachine.hpp"
 #include "ui/manipulators.hpp"
 #include "ui/drawobject.hpp"
+#include "ui/drawobjectpool.hpp"
+#include "ui/spatialindex.hpp"
+#include "ui/framescheduler.hpp"
+#include "ui/spacetime.hpp"
 #include <imgui.h>
+#include <cstdint>
 #include <map>
 #include <set>
 #include <vector>
 #include <memory>
 #include <string>
+#include <utility>
 
 
 namespace ImGui {
   class FileBrowser;
 }
 
+class EditJournal;
+
 
 class AppState {
 public:
@@ -28,15 +36,46 @@ private:
   AppState::Menu menu_ = Menu::SELECT;
   std::map<core::State, ImVec2> stateToPosition_;
   ImVec2 canvasOrigin_;
-  std::vector<std::unique_ptr<ui::DrawObject>> drawObjects_;
+  ui::DrawObjectPool<ui::StateDrawObject> statePool_;
+  ui::DrawObjectPool<ui::TransitionDrawObject> transitionPool_;
+  ui::DrawObjectPool<ui::TransitionLabelDrawObject> labelPool_;
   std::string windowTitle_;
   ui::TransitionLabelEditor labelEditor_;
   ui::StateEditor stateEditor_;
   ImVec2 scrollXY_;
+  utils::Rect viewport_;
+  float zoom_ = 1.0f;
+  ImVec2 canvasExtent_;
+  uint64_t layoutVersion_ = 1;
   std::set<std::string> popupNames_;
   ui::SelectionDrawObject selectionObj_;
+  EditJournal *journal_ = nullptr;
+  ui::SpatialIndex spatialIndex_;
+  std::map<core::State, ui::StateDrawObject *> stateObjects_;
+  std::vector<ui::DrawObject *> drawnEdges_;  // transitions and labels drawn last frame, sorted
+  ui::FrameScheduler frameScheduler_;
+  ui::SpaceTimeDiagram spaceTime_;
+  std::vector<core::State> unplacedStates_;
 
   ui::TransitionDrawObject *createTransitionObject(const core::Transition &trans);
+  ui::StateDrawObject *createStateObject(const core::State &state);
+  // Drops the objects (and the transitions' labels) from the pools and the indexes.
+  void destroyDrawObjects(const std::vector<ui::TransitionDrawObject *> &transitions, const std::vector<ui::StateDrawObject *> &states);
+  // Calls f on every draw object with its concrete type: transitions, then states, then
+  // labels, which is also the drawing order.
+  template <class F> void forEachDrawObject(F &&f) {
+    transitionPool_.forEach(f);
+    statePool_.forEach(f);
+    labelPool_.forEach(f);
+  }
+  template <class F> void forEachDrawObject(F &&f) const {
+    transitionPool_.forEach(f);
+    statePool_.forEach(f);
+    labelPool_.forEach(f);
+  }
+  void indexState(const core::State &state);
+  void storeStatePosition(const core::State &state, ImVec2 canvasPos);
+  void listenToExecutor();
 
 public:
   AppState();
@@ -53,8 +92,15 @@ public:
   void setWindowTitle(const std::string &s) { windowTitle_ = s; }
 
   ImVec2 statePosition(const core::State &state) const;
+  bool hasStatePosition(const core::State &state) const { return stateToPosition_.count(state) != 0; }
   void removeStatePosition(const core::State &state);
   void setStatePosition(const core::State &state, ImVec2 pos);
+  // Moves states to canvas positions in one go, skipping states no longer in the machine.
+  // The moves are journaled only when `record` is set, so a layout in progress does not
+  // flood the journal.
+  void placeStates(const std::vector<core::State> &states, const std::vector<ImVec2> &canvasPos, bool record);
+  // Bumped whenever a state position changes, so geometry derived from positions can be cached.
+  uint64_t layoutVersion() const { return layoutVersion_; }
 
   const ui::TransitionLabelEditor &transitionLabelEditor() const { return labelEditor_; }
   ui::TransitionLabelEditor &transitionLabelEditor() { return labelEditor_; }
@@ -67,36 +113,78 @@ public:
   void removeState(const core::State &state);
   void removeTransition(const core::Transition &trans);
   void updateState(const core::State &what, const core::State &with);
+  void updateTransition(const core::Transition &what, const core::Transition &with);
+  // Bulk versions of the above: one pass over the machine and the draw objects however
+  // many are affected. Positions are screen coordinates, one per state.
+  void addStates(const std::vector<core::State> &states, const std::vector<ImVec2> &positions);
+  void addTransitions(const std::vector<core::Transition> &transitions);
+  void removeStates(const std::vector<core::State> &states);
+  void removeTransitions(const std::vector<core::Transition> &transitions);
+  void writeTapeCell(int index, char symbol);
+  // Code for a symbol typed by the user, interning (and journaling) it if new. nullopt,
+  // with a message, once the machine has no codes left.
+  std::optional<char> internSymbol(const std::string &name);
 
   // --- Coordinate transformations ---
   void setCanvasOrigin(const ImVec2 &o);
   ImVec2 canvasOrigin() const { return canvasOrigin_; }
   void setScrollXY(const ImVec2 &s) { scrollXY_ = s; }
   ImVec2 scrollXY() const { return scrollXY_; }
+  // Visible part of the canvas in screen coordinates; objects outside it are not drawn.
+  void setViewport(const utils::Rect &rc) { viewport_ = rc; }
+  const utils::Rect &viewport() const { return viewport_; }
+  // Canvas units are scaled by zoom() on screen.
+  float zoom() const { return zoom_; }
+  // Sets the zoom, keeping the canvas point under the screen point `anchor` in place.
+  void zoomAt(float zoom, const ImVec2 &anchor);
+  // Below this zoom the canvas is drawn as an overview: states as dots, transitions as
+  // plain segments, no text or handles.
+  bool isOverview() const;
+  // Whether text scaled by the zoom is still large enough to be worth drawing.
+  bool showsText() const;
+  // Largest state position seen, in canvas coordinates; sizes the scrollable area.
+  ImVec2 canvasExtent() const { return canvasExtent_; }
   ImVec2 screenToCanvas(const ImVec2 &mouse) const;
   ImVec2 canvasToScreen(const ImVec2 &p) const;
   utils::Rect canvasToScreen(const utils::Rect &p) const;
+  utils::Rect screenToCanvas(const utils::Rect &p) const;
 
   // --- Object handling ---
   ui::DrawObject *targetObject(const ImVec2 &pos) const;
+  // Draw objects whose boxes intersect the screen rect rc, in drawing order.
+  void queryObjects(const utils::Rect &rc, std::vector<ui::DrawObject *> &out) const;
+  // Called by transitions and labels once draw() has laid them out; at most MaxHitBoxes
+  // boxes, in screen coordinates.
+  static constexpr size_t MaxHitBoxes = 4;
+  void updateSpatialIndex(const ui::DrawObject *obj, const utils::Rect *boxes, size_t n);
   void drawObjects(ImDrawList *dr);
   void clearDrawObjects();
   void clearManipulators();
   void removeSelected();
   std::vector<ui::Manipulator *> getManipulators() const;
-  size_t nofDrawObjects() const { return drawObjects_.size(); }
-  const ui::DrawObject *getDrawObject(size_t i) const { return drawObjects_.at(i).get(); }
+  // Draw objects by type. Right after rebuildDrawObjectsFromTM() the transition pool is in
+  // transition order; later edits reuse freed slots, so it is not kept that way.
+  size_t nofDrawObjects() const { return statePool_.size() + transitionPool_.size() + labelPool_.size(); }
+  const ui::DrawObjectPool<ui::StateDrawObject> &statePool() const { return statePool_; }
+  ui::DrawObjectPool<ui::TransitionDrawObject> &transitionPool() { return transitionPool_; }
+  const ui::DrawObjectPool<ui::TransitionDrawObject> &transitionPool() const { return transitionPool_; }
+  ui::DrawObjectPool<ui::TransitionLabelDrawObject> &labelPool() { return labelPool_; }
+  const ui::DrawObjectPool<ui::TransitionLabelDrawObject> &labelPool() const { return labelPool_; }
 #if 0
-  ui::DrawObject *lastAddedDrawObject() { return drawObjects_.back().get(); }
   void updateObjects();
 #endif
   void rebuildDrawObjectsFromTM();
+  // States the last rebuild found without a position and put on a provisional grid, for
+  // the UI to lay out properly. Cleared when taken.
+  std::vector<core::State> takeUnplacedStates() { return std::exchange(unplacedStates_, {}); }
   ui::SelectionDrawObject &selectionObj() { return selectionObj_; }
   const ui::SelectionDrawObject &selectionObj() const { return selectionObj_; }
   bool isActiveSelection() const { return selectionObj_.getManipulator(); }
 
   // --- Execution ---
   void startExecution();
+  // Runs without the step delay until a breakpoint or the end of the machine.
+  void runToBreakpoint();
   void pauseExecution();
   void stepExecution();
   void stopExecution();
@@ -110,10 +198,35 @@ public:
   size_t getCellsUsed() const { return executor_.cellsUsed(); }
   std::pair<int, int> getTapeRange() const { return tm().tape().getUsedRange(); }
   size_t getStepCount() const { return executor_.stepCount(); }
+  // Kept across reset(); applies to the run in progress too.
+  const core::ExecutionBudget &executionBudget() const { return executor_.budget(); }
+  void setExecutionBudget(const core::ExecutionBudget &b) { executor_.setBudget(b); }
+  core::ExecutionBudget::Limit exceededLimit() const { return executor_.exceededLimit(); }
+  // Stops the run from any thread; see core::CancellationToken. The same token serves
+  // every machine, across reset().
+  core::CancellationToken cancellationToken() const { return executor_.cancellationToken(); }
+  core::Breakpoints &breakpoints() { return executor_.breakpoints(); }
+  const core::Breakpoints &breakpoints() const { return executor_.breakpoints(); }
+  // Breakpoints::Kind mask of what the last step hit.
+  uint8_t breakpointHit() const { return executor_.breakpointHit(); }
+  const std::optional<core::StepEvent> &watchHit() const { return executor_.watchHit(); }
+  // Sets a breakpoint on every selected state and transition, or clears them all if each
+  // already has one.
+  void toggleSelectedBreakpoints();
+  // Tape history of the current run, fed by the executor's steps.
+  ui::SpaceTimeDiagram &spaceTime() { return spaceTime_; }
 
   // --- Misc ---
+  ui::FrameScheduler &frameScheduler() { return frameScheduler_; }
+  // Edits made through the methods above are recorded here when set.
+  void setJournal(EditJournal *j) { journal_ = j; }
+  EditJournal *journal() const { return journal_; }
   static ImGui::FileBrowser &fileBrowserSave();
   static ImGui::FileBrowser &fileBrowserOpen();
+  // Tape import/export get their own dialogs, so a selection is never taken for the
+  // machine's load/save.
+  static ImGui::FileBrowser &fileBrowserTapeImport();
+  static ImGui::FileBrowser &fileBrowserTapeExport();
 
   void registerPopupName(const std::string &s);
   bool hasOpenPopup() const;
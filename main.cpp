@@ -6,6 +6,7 @@
 
 #include "ui/render.hpp"
 #include "ui/fa_icons.hpp"
+#include "ui/journal.hpp"
 #include "app.hpp"
 
 
@@ -54,6 +55,11 @@ int main() {
 
   AppState state;
 
+  // Replay what a session that crashed left behind, then record edits from here on.
+  EditJournal journal("autosave");
+  journal.recover(state);
+  state.setJournal(&journal);
+
   //auto &tape = state.tm().tape();
   //char a[4] = {'A', 'B', 'C', 'D'};
   //for (int j = 0; j < 20; j ++) {
@@ -69,9 +75,20 @@ int main() {
   //state.setStatePosition(core::State("qReject", core::State::Type::REJECT), ImVec2(800, 200));
 
 
-  // Main loop
+  // Main loop; sleeps until there is input or the scheduler has a frame due.
+  auto &scheduler = state.frameScheduler();
+  std::string shownTitle;
   while (!glfwWindowShouldClose(window)) {
-    glfwPollEvents();
+    if (auto timeout = scheduler.waitTimeout()) {
+      if (*timeout > 0) {
+        glfwWaitEventsTimeout(*timeout);
+      } else {
+        glfwPollEvents();
+      }
+    } else {
+      glfwWaitEvents();
+    }
+    scheduler.wokeUp();
 
     // Start the Dear ImGui frame
     ImGui_ImplOpenGL3_NewFrame();
@@ -82,10 +99,14 @@ int main() {
     if (!state.windowTitle().empty()) {
       title += " - " + state.windowTitle();
     }
-    glfwSetWindowTitle(window, title.c_str());
+    if (title != shownTitle) {
+      glfwSetWindowTitle(window, title.c_str());
+      shownTitle = title;
+    }
 
     state.updateExecution();
     ui::render(state);
+    journal.compactIfDue(state);
 
     // Rendering
     ImGui::Render();
@@ -100,6 +121,9 @@ int main() {
   }
 
   // Cleanup
+  state.setJournal(nullptr);
+  journal.close();
+  state.spaceTime().releaseTexture();
   ImGui_ImplOpenGL3_Shutdown();
   ImGui_ImplGlfw_Shutdown();
   ImGui::DestroyContext();
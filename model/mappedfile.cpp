@@ -0,0 +1,113 @@
+#include "model/mappedfile.hpp"
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+utils::MappedFile::MappedFile(MappedFile &&o) noexcept
+{
+  *this = std::move(o);
+}
+
+utils::MappedFile &utils::MappedFile::operator=(MappedFile &&o) noexcept
+{
+  if (this != &o) {
+    close();
+    std::swap(data_, o.data_);
+    std::swap(size_, o.size_);
+#ifdef _WIN32
+    std::swap(file_, o.file_);
+    std::swap(mapping_, o.mapping_);
+#else
+    std::swap(fd_, o.fd_);
+#endif
+  }
+  return *this;
+}
+
+#ifdef _WIN32
+
+bool utils::MappedFile::open(const std::string &path)
+{
+  close();
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE) return false;
+  LARGE_INTEGER sz{};
+  if (!GetFileSizeEx(file, &sz) || sz.QuadPart == 0) {
+    CloseHandle(file);
+    return false;
+  }
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!mapping) {
+    CloseHandle(file);
+    return false;
+  }
+  void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!view) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+  file_ = file;
+  mapping_ = mapping;
+  data_ = static_cast<const char *>(view);
+  size_ = static_cast<size_t>(sz.QuadPart);
+  return true;
+}
+
+void utils::MappedFile::close()
+{
+  if (data_) UnmapViewOfFile(data_);
+  if (mapping_) CloseHandle(mapping_);
+  if (file_) CloseHandle(file_);
+  data_ = nullptr;
+  mapping_ = nullptr;
+  file_ = nullptr;
+  size_ = 0;
+}
+
+#else
+
+bool utils::MappedFile::open(const std::string &path)
+{
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st {};
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+  void *p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  if (p == MAP_FAILED) {
+    ::close(fd);
+    return false;
+  }
+  madvise(p, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+  fd_ = fd;
+  data_ = static_cast<const char *>(p);
+  size_ = static_cast<size_t>(st.st_size);
+  return true;
+}
+
+void utils::MappedFile::close()
+{
+  if (data_) munmap(const_cast<char *>(data_), size_);
+  if (fd_ >= 0) ::close(fd_);
+  data_ = nullptr;
+  size_ = 0;
+  fd_ = -1;
+}
+
+#endif
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+
+namespace utils {
+
+  // Read-only memory mapping of a whole file. Falls back to an empty view when the
+  // file is missing or empty; check isOpen() before using data().
+  class MappedFile {
+  public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string &path) { open(path); }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&o) noexcept;
+    MappedFile &operator=(MappedFile &&o) noexcept;
+    ~MappedFile() { close(); }
+
+    bool open(const std::string &path);
+    void close();
+    bool isOpen() const { return data_ != nullptr; }
+    const char *data() const { return data_; }
+    size_t size() const { return size_; }
+
+  private:
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void *file_ = nullptr;
+    void *mapping_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+  };
+
+} // namespace utils
@@ -0,0 +1,53 @@
+#include "model/tapeio.hpp"
+#include "model/turingmachine.hpp"
+#include "model/mappedfile.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+
+bool core::importRawTape(Tape &tape, const std::string &path, int start, size_t *cellsWritten)
+{
+  utils::MappedFile mf(path);
+  if (!mf.isOpen()) {
+    std::cerr << "Tape import error: cannot map " << path << std::endl;
+    return false;
+  }
+  if (static_cast<long long>(start) + static_cast<long long>(mf.size()) - 1 > (std::numeric_limits<int>::max)()) {
+    std::cerr << "Tape import error: " << path << " does not fit on the tape at " << start << std::endl;
+    return false;
+  }
+  tape.writeRange(start, mf.data(), mf.size());
+  if (cellsWritten) *cellsWritten = mf.size();
+  return true;
+}
+
+bool core::exportRawTape(const Tape &tape, const std::string &path, size_t *cellsWritten)
+{
+  std::ofstream file(path, std::ios::binary);
+  if (!file) {
+    std::cerr << "Tape export error: cannot open " << path << std::endl;
+    return false;
+  }
+  size_t total = 0;
+  if (!tape.isEmpty()) {
+    auto [first, last] = tape.getUsedRange();
+    const size_t n = static_cast<size_t>(static_cast<long long>(last) - first + 1);
+    std::vector<char> chunk(size_t(1) << 20);
+    while (total < n) {
+      const size_t len = (std::min)(chunk.size(), n - total);
+      tape.readRange(first + static_cast<int>(total), chunk.data(), len);
+      file.write(chunk.data(), static_cast<std::streamsize>(len));
+      total += len;
+    }
+  }
+  file.close();
+  if (!file) {
+    std::cerr << "Tape export error: failed writing " << path << std::endl;
+    return false;
+  }
+  if (cellsWritten) *cellsWritten = total;
+  return true;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+
+namespace core {
+
+  class Tape;
+
+  // Raw tape files hold one byte per cell; byte 0 is the blank symbol.
+
+  // Maps `path` and copies its bytes onto the tape starting at cell `start`.
+  // Returns false (and leaves the tape untouched) if the file cannot be read.
+  bool importRawTape(Tape &tape, const std::string &path, int start, size_t *cellsWritten = nullptr);
+
+  // Streams the used range of the tape to `path`, blanks included.
+  bool exportRawTape(const Tape &tape, const std::string &path, size_t *cellsWritten = nullptr);
+
+} // namespace core
@@ -1,8 +1,19 @@
 #include "turingmachine.hpp"
 #include <nlohmann/json.hpp>
 #include <format>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_set>
 
 
+namespace {
+  // Bits per tape cell for a palette of n symbols, blank included.
+  int bitsFor(size_t n) {
+    return n <= 2 ? 1 : n <= 4 ? 2 : 8;
+  }
+}
+
 void core::Tape::move(Dir dir)
 {
   switch (dir) {
@@ -12,66 +23,430 @@ void core::Tape::move(Dir dir)
   }
 }
 
+const core::Tape::Page *core::Tape::findPage(int page) const
+{
+  auto it = pages_.find(page);
+  return it == pages_.end() ? nullptr : &it->second;
+}
+
+core::Tape::Page &core::Tape::pageAt(int page)
+{
+  auto it = pages_.lower_bound(page);
+  if (it == pages_.end() || it->first != page) {
+    it = pages_.emplace_hint(it, page, Page{ std::vector<uint64_t>(PageSize * bits_ / 64), 0 });
+  }
+  return it->second;
+}
+
+void core::Tape::setCell(Page &page, int offset, char c)
+{
+  if (bits_ == 8) {
+    reinterpret_cast<char *>(page.words.data())[offset] = c;
+    return;
+  }
+  const int bit = offset * bits_;
+  const uint64_t mask = ((uint64_t(1) << bits_) - 1) << (bit & 63);
+  auto &word = page.words[bit >> 6];
+  word = (word & ~mask) | (uint64_t(paletteIndex_[static_cast<unsigned char>(c)]) << (bit & 63));
+}
+
+void core::Tape::admit(const char *symbols, size_t n)
+{
+  if (bits_ == 8) return;
+  std::vector<char> extra;
+  for (size_t i = 0; i < n; i ++) {
+    if (paletteIndex_[static_cast<unsigned char>(symbols[i])] == NotInPalette
+      && std::find(extra.begin(), extra.end(), symbols[i]) == extra.end()) {
+      extra.push_back(symbols[i]);
+    }
+  }
+  if (extra.empty()) return;
+  std::vector<char> palette{ Blank };
+  for (int i = 1; i < (1 << bits_); i ++) {
+    if (palette_[i] != Blank) palette.push_back(palette_[i]);
+  }
+  palette.insert(palette.end(), extra.begin(), extra.end());
+  repack(bitsFor(palette.size()), palette);
+}
+
+void core::Tape::repack(int bits, const std::vector<char> &palette)
+{
+  std::array<char, PageSize> cells;
+  const int oldBits = bits_;
+  auto oldPalette = palette_;
+  auto decode = [&](const Page &page) {
+    for (int i = 0; i < PageSize; i ++) {
+      if (oldBits == 8) {
+        cells[i] = reinterpret_cast<const char *>(page.words.data())[i];
+      } else {
+        const int bit = i * oldBits;
+        cells[i] = oldPalette[(page.words[bit >> 6] >> (bit & 63)) & ((1u << oldBits) - 1)];
+      }
+    }
+  };
+  bits_ = bits;
+  palette_.fill(Blank);
+  paletteIndex_.fill(NotInPalette);
+  if (bits < 8) {
+    for (size_t i = 0; i < palette.size(); i ++) {
+      palette_[i] = palette[i];
+      paletteIndex_[static_cast<unsigned char>(palette[i])] = static_cast<uint8_t>(i);
+    }
+  }
+  for (auto &[pageNo, page] : pages_) {
+    decode(page);
+    page.words.assign(PageSize * bits_ / 64, 0);
+    page.filled = 0;
+    for (int i = 0; i < PageSize; i ++) {
+      setCell(page, i, cells[i]);
+    }
+    for (uint64_t w : page.words) {
+      page.filled += std::popcount(nonBlankMask(w));
+    }
+  }
+}
+
+void core::Tape::pack(const std::set<char> &symbols)
+{
+  std::vector<char> palette{ Blank };
+  for (char c : alphabet()) palette.push_back(c);
+  for (char c : symbols) {
+    if (c != Blank && std::find(palette.begin(), palette.end(), c) == palette.end()) palette.push_back(c);
+  }
+  const int bits = bitsFor(palette.size());
+  if (bits == bits_ && (bits == 8 || std::all_of(palette.begin(), palette.end(),
+    [this](char c) { return paletteIndex_[static_cast<unsigned char>(c)] != NotInPalette; }))) {
+    return;
+  }
+  repack(bits, palette);
+}
+
+size_t core::Tape::memoryUsage() const
+{
+  return pages_.size() * (sizeof(Page) + PageSize * bits_ / 8);
+}
+
+void core::Tape::growExtent(int first, int last)
+{
+  if (!extent_) {
+    extent_ = { first, last };
+  } else {
+    extent_->first = (std::min)(extent_->first, first);
+    extent_->second = (std::max)(extent_->second, last);
+  }
+}
+
+void core::Tape::count(Page &page, char oldSymbol, char newSymbol)
+{
+  if (oldSymbol != Tape::Blank) {
+    symbolCounts_[static_cast<unsigned char>(oldSymbol)] --;
+    nonBlank_ --;
+    page.filled --;
+  }
+  if (newSymbol != Tape::Blank) {
+    symbolCounts_[static_cast<unsigned char>(newSymbol)] ++;
+    nonBlank_ ++;
+    page.filled ++;
+  }
+}
+
+char core::Tape::readAt(int index) const
+{
+  const Page *page = findPage(pageOf(index));
+  return page ? cellAt(*page, offsetOf(index)) : Tape::Blank;
+}
+
 void core::Tape::writeAt(int index, char c)
 {
-  if (cells_[index] != c) alphabet_.clear();
-  else if (c != Tape::Blank) alphabet_.insert(c);
-  cells_[index] = c;
+  admit(&c, 1);
+  Page &page = pageAt(pageOf(index));
+  const int offset = offsetOf(index);
+  const char old = cellAt(page, offset);
+  count(page, old, c);
+  setCell(page, offset, c);
+  growExtent(index, index);
+  version_++;
+  if (!watches_.empty() && old != c) checkWatches(index, c);
+}
+
+void core::Tape::checkWatches(int index, char c)
+{
+  if (watchHit_) return;
+  for (const auto &w : watches_) {
+    if (w.first > index) break;
+    if (index <= w.last && (!w.symbol || *w.symbol == c)) {
+      watchHit_ = { index, c };
+      return;
+    }
+  }
+}
+
+void core::Tape::setWatchpoints(std::vector<Watchpoint> watches)
+{
+  std::sort(watches.begin(), watches.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+  watches_ = std::move(watches);
+  watchHit_.reset();
+}
+
+void core::Tape::writeRange(int start, const char *data, size_t n)
+{
+  if (n == 0) return;
+  if (!watches_.empty()) {
+    // Cell by cell, so each change is checked against the watches.
+    for (size_t i = 0; i < n; i ++) writeAt(start + static_cast<int>(i), data[i]);
+    return;
+  }
+  admit(data, n);
+  size_t done = 0;
+  while (done < n) {
+    const int index = start + static_cast<int>(done);
+    const int offset = offsetOf(index);
+    const size_t chunk = (std::min)(n - done, static_cast<size_t>(PageSize - offset));
+    Page &page = pageAt(pageOf(index));
+    if (bits_ == 8) {
+      char *dst = reinterpret_cast<char *>(page.words.data()) + offset;
+      for (size_t i = 0; i < chunk; i ++) {
+        count(page, dst[i], data[done + i]);
+      }
+      std::memcpy(dst, data + done, chunk);
+    } else {
+      for (size_t i = 0; i < chunk; i ++) {
+        const int cell = offset + static_cast<int>(i);
+        count(page, cellAt(page, cell), data[done + i]);
+        setCell(page, cell, data[done + i]);
+      }
+    }
+    done += chunk;
+  }
+  growExtent(start, start + static_cast<int>(n - 1));
+  version_++;
+}
+
+void core::Tape::readRange(int start, char *out, size_t n) const
+{
+  size_t done = 0;
+  while (done < n) {
+    const int index = start + static_cast<int>(done);
+    const int offset = offsetOf(index);
+    const size_t chunk = (std::min)(n - done, static_cast<size_t>(PageSize - offset));
+    if (const Page *page = findPage(pageOf(index))) {
+      if (bits_ == 8) {
+        std::memcpy(out + done, reinterpret_cast<const char *>(page->words.data()) + offset, chunk);
+      } else {
+        for (size_t i = 0; i < chunk; i ++) {
+          out[done + i] = cellAt(*page, offset + static_cast<int>(i));
+        }
+      }
+    } else {
+      std::memset(out + done, Tape::Blank, chunk);
+    }
+    done += chunk;
+  }
+}
+
+void core::Tape::clear()
+{
+  pages_.clear();
+  extent_.reset();
+  symbolCounts_.fill(0);
+  nonBlank_ = 0;
+  headPosition_ = 0;
+  version_++;
 }
 
 std::set<char> core::Tape::alphabet() const
 {
-  if (alphabet_.empty()) {
-    for (const auto &p : cells_)
-      if (p.second != Tape::Blank) alphabet_.insert(p.second);
+  std::set<char> res;
+  for (size_t c = 0; c < symbolCounts_.size(); c ++) {
+    if (symbolCounts_[c]) res.insert(static_cast<char>(c));
   }
-  return alphabet_;
+  return res;
+}
+
+namespace {
+  // Blanks bridged inside one saved tape segment before a new segment is started.
+  constexpr int TapeSegmentGap = 16;
 }
 
 nlohmann::json core::Tape::toJson() const
 {
+  // v2 layout: each segment stores its run symbols as one string plus the run
+  // lengths; "runs" is omitted when every run has length 1.
   using nlohmann::json;
   json j;
+  j["version"] = 2;
   j["headPosition"] = headPosition_;
-  j["cells"] = json::array();
-  for (const auto &p : cells_) {
-    if (p.second != Tape::Blank) {
-      j["cells"].push_back({ {"index", p.first}, {"symbol", std::string(1, p.second)} });
+  j["segments"] = json::array();
+  forEachSegment(TapeSegmentGap, [&](int start, const std::string &cells) {
+    std::string symbols;
+    std::vector<size_t> runs;
+    for (size_t i = 0; i < cells.size();) {
+      size_t k = i + 1;
+      while (k < cells.size() && cells[k] == cells[i]) k++;
+      symbols.push_back(cells[i]);
+      runs.push_back(k - i);
+      i = k;
     }
-  }
+    json seg{ {"start", start}, {"symbols", codesToUtf8(symbols)} };
+    if (runs.size() != cells.size()) seg["runs"] = runs;
+    j["segments"].push_back(std::move(seg));
+    });
   return j;
 }
 
 void core::Tape::fromJson(const nlohmann::json &j)
 {
+  clear();
   headPosition_ = j.value("headPosition", 0);
-  cells_.clear();
-  alphabet_.clear();
-  for (const auto &item : j["cells"]) {
-    int index = item.value("index", 0);
-    std::string symbolStr = item.value("symbol", "");
-    char symbol = symbolStr.empty() ? Tape::Blank : symbolStr[0];
-    writeAt(index, symbol);
+  if (j.contains("segments")) {
+    for (const auto &item : j["segments"]) {
+      segmentFromJson(item);
+    }
+  } else if (j.contains("cells")) {
+    for (const auto &item : j["cells"]) {
+      cellFromJson(item);
+    }
+  }
+}
+
+void core::Tape::cellFromJson(const nlohmann::json &item)
+{
+  int index = item.value("index", 0);
+  std::string symbolStr = codesFromUtf8(item.value("symbol", ""));
+  char symbol = symbolStr.empty() ? Tape::Blank : symbolStr[0];
+  writeAt(index, symbol);
+}
+
+void core::Tape::segmentFromJson(const nlohmann::json &item)
+{
+  const int start = item.at("start").get<int>();
+  const std::string symbols = codesFromUtf8(item.at("symbols").get_ref<const std::string &>());
+  if (!item.contains("runs")) {
+    writeRange(start, symbols.data(), symbols.size());
+    return;
+  }
+  const auto &runs = item.at("runs");
+  if (runs.size() != symbols.size()) {
+    throw std::runtime_error("tape segment at " + std::to_string(start) + " has mismatched runs");
+  }
+  std::string cells;
+  for (size_t i = 0; i < symbols.size(); i ++) {
+    cells.append(runs[i].get<size_t>(), symbols[i]);
   }
+  writeRange(start, cells.data(), cells.size());
 }
 
 size_t core::Tape::getNonBlankCellCount() const
 {
-  size_t count = 0;
-  for (const auto &[pos, symbol] : cells_) {
-    if (symbol != Blank) {
-      count++;
+  return nonBlank_;
+}
+
+std::pair<int, int> core::Tape::getUsedRange() const
+{
+  return extent_.value_or(std::pair<int, int>{ 0, 0 });
+}
+
+
+//------------------------------------------------------------------------------------------
+
+
+std::string core::codesToUtf8(std::string_view codes)
+{
+  std::string text;
+  text.reserve(codes.size());
+  for (char c : codes) {
+    const auto u = static_cast<unsigned char>(c);
+    if (u < 0x80) {
+      text.push_back(c);
+    } else {
+      text.push_back(static_cast<char>(0xC0 | (u >> 6)));
+      text.push_back(static_cast<char>(0x80 | (u & 0x3F)));
     }
   }
-  return count;
+  return text;
 }
 
-std::pair<int, int> core::Tape::getUsedRange() const
+std::string core::codesFromUtf8(std::string_view text)
+{
+  std::string codes;
+  codes.reserve(text.size());
+  for (size_t i = 0; i < text.size(); i ++) {
+    const auto u = static_cast<unsigned char>(text[i]);
+    if ((u == 0xC2 || u == 0xC3) && i + 1 < text.size()) {
+      codes.push_back(static_cast<char>(((u & 0x1F) << 6) | (static_cast<unsigned char>(text[++i]) & 0x3F)));
+    } else {
+      codes.push_back(text[i]);
+    }
+  }
+  return codes;
+}
+
+namespace {
+  // Codes handed out to interned names, the high half first.
+  constexpr auto InternOrder = [] {
+    std::array<unsigned char, 160> order{};
+    size_t n = 0;
+    for (int c = 0x80; c <= 0xFF; c ++) order[n++] = static_cast<unsigned char>(c);
+    for (int c = 0x01; c < 0x20; c ++) order[n++] = static_cast<unsigned char>(c);
+    order[n++] = 0x7F;
+    return order;
+  }();
+}
+
+core::SymbolTable::SymbolTable()
 {
-  if (cells_.empty()) return { 0, 0 };
-  auto [minIt, maxIt] = std::minmax_element(cells_.begin(), cells_.end(),
-    [](const auto &a, const auto &b) { return a.first < b.first; });
-  return { minIt->first, maxIt->first };
+  for (int c = 0x20; c < 0x7f; c ++) {
+    names_[c] = std::string(1, char(c));
+  }
+}
+
+std::optional<char> core::SymbolTable::find(const std::string &name) const
+{
+  if (name.empty()) return Tape::Blank;
+  if (name.size() == 1 && isPlain(name[0])) return name[0];
+  auto it = interned_.find(name);
+  if (it == interned_.end()) return std::nullopt;
+  return it->second;
+}
+
+std::optional<char> core::SymbolTable::intern(const std::string &name)
+{
+  if (auto code = find(name)) return code;
+  for (auto u : InternOrder) {
+    if (names_[u].empty()) {
+      define(name, static_cast<char>(u));
+      return static_cast<char>(u);
+    }
+  }
+  return std::nullopt;
+}
+
+bool core::SymbolTable::define(const std::string &name, char code)
+{
+  if (auto known = find(name)) return *known == code;
+  auto &slot = names_[static_cast<unsigned char>(code)];
+  if (code == Tape::Blank || isPlain(code) || !slot.empty()) return false;
+  slot = name;
+  interned_.emplace(name, code);
+  return true;
+}
+
+nlohmann::json core::SymbolTable::toJson() const
+{
+  auto j = nlohmann::json::object();
+  forEachInterned([&](const std::string &name, char code) {
+    j[name] = static_cast<unsigned char>(code);
+    });
+  return j;
+}
+
+void core::SymbolTable::fromJson(const nlohmann::json &j)
+{
+  for (const auto &[name, code] : j.items()) {
+    if (!define(name, static_cast<char>(code.get<unsigned char>()))) {
+      throw std::runtime_error("symbol '" + name + "' conflicts with another symbol");
+    }
+  }
 }
 
 
@@ -113,18 +488,32 @@ std::string core::executionStateToStr(ExecutionState s)
   case ExecutionState::STEP_MODE: return "STEP_MODE";
   case ExecutionState::FINISHED: return "FINISHED";
   case ExecutionState::ERROR: return "ERROR";
+  case ExecutionState::BUDGET_EXCEEDED: return "BUDGET_EXCEEDED";
+  case ExecutionState::CANCELLED: return "CANCELLED";
   }
   return "UNKNOWN";
 }
 
+std::string core::budgetLimitToStr(ExecutionBudget::Limit l)
+{
+  switch (l) {
+  case ExecutionBudget::Limit::NONE: return "none";
+  case ExecutionBudget::Limit::STEPS: return "steps";
+  case ExecutionBudget::Limit::WALL_TIME: return "time";
+  case ExecutionBudget::Limit::TAPE_CELLS: return "tape cells";
+  case ExecutionBudget::Limit::MEMORY: return "memory";
+  }
+  return "unknown";
+}
+
 
 //------------------------------------------------------------------------------------------
 
 
 std::string core::Transition::uniqueKey() const
 {
-  auto key = from().name() + "_" + std::string(1, readSymbol()) +
-    "_" + to().name() + "_" + std::string(1, writeSymbol()) +
+  auto key = from().name() + "_" + codesToUtf8(std::string_view(&readSymbol_, 1)) +
+    "_" + to().name() + "_" + codesToUtf8(std::string_view(&writeSymbol_, 1)) +
     "_" + dirToStr(direction());
   //std::hash<std::string> hasher;
   //return std::to_string(hasher(key));
@@ -148,16 +537,19 @@ core::TuringMachine::TuringMachine()
   //currentState_ = q0;
 }
 
-void core::TuringMachine::step()
+bool core::TuringMachine::step()
 {
-  if (!tapeBackup_.has_value())
+  if (!tapeBackup_.has_value()) {
     tapeBackup_ = tape_;
+    tapeBackup_->setWatchpoints({});
+  }
   char currentSymbol = tape_.read();
   bool found = false;
-  for (const auto &t : transitions_) {
-    if (t.from() == currentState_ && t.readSymbol() == currentSymbol) {
+  for (size_t i : transitionsFrom(currentState_)) {
+    const auto &t = transitions_[i];
+    if (t.readSymbol() == currentSymbol) {
       currentState_ = t.to();
-      lastExecutedTransition_ = t.uniqueKey();
+      lastExecutedTransition_ = t.id();
       tape_.write(t.writeSymbol());
       tape_.move(t.direction());
       found = true;
@@ -167,20 +559,29 @@ void core::TuringMachine::step()
   if (!found) {
     // No valid transition, halt the machine (could also set to a reject state)
     currentState_ = State("HALT", State::Type::REJECT);
+    lastExecutedTransition_ = 0;
   }
+  return found;
 }
 
 void core::TuringMachine::reset()
 {
-  for (const auto &st : states()) {
-    if (st.isStart()) {
-      currentState_ = st;
-      break;
-    }
+  if (auto st = startState()) {
+    currentState_ = *st;
   }
   if (tapeBackup_.has_value())
     tape_ = tapeBackup_.value();
   tapeBackup_.reset();
+  packTape();
+}
+
+void core::TuringMachine::packTape()
+{
+  std::set<char> written;
+  for (const auto &t : transitions_) {
+    written.insert(t.writeSymbol());
+  }
+  tape_.pack(written);
 }
 
 bool core::TuringMachine::isAccepting() const
@@ -193,8 +594,9 @@ bool core::TuringMachine::isRejecting() const
   return currentState_.isReject();
 }
 
-std::vector<core::State> core::TuringMachine::states() const
+void core::TuringMachine::refreshDerived() const
 {
+  if (derivedGeneration_ == generation_) return;
   std::set<State> uniqueStates;
   for (const auto &t : transitions_) {
     uniqueStates.insert(t.from());
@@ -203,42 +605,111 @@ std::vector<core::State> core::TuringMachine::states() const
   for (const auto &st : unconnectedStates_) {
     uniqueStates.insert(st);
   }
-  return std::vector<State>(uniqueStates.begin(), uniqueStates.end());
+  statesCache_.assign(uniqueStates.begin(), uniqueStates.end());
+  stateIndex_.clear();
+  stateIndex_.reserve(statesCache_.size());
+  startStateCache_.reset();
+  for (size_t i = 0; i < statesCache_.size(); i ++) {
+    stateIndex_.emplace(statesCache_[i].name(), i);
+    if (!startStateCache_ && statesCache_[i].isStart()) {
+      startStateCache_ = statesCache_[i];
+    }
+  }
+  derivedGeneration_ = generation_;
+}
+
+const std::vector<core::State> &core::TuringMachine::states() const
+{
+  refreshDerived();
+  return statesCache_;
+}
+
+std::optional<core::State> core::TuringMachine::findState(const std::string &name) const
+{
+  refreshDerived();
+  auto it = stateIndex_.find(name);
+  if (it == stateIndex_.end()) return std::nullopt;
+  return statesCache_[it->second];
+}
+
+std::optional<core::State> core::TuringMachine::startState() const
+{
+  refreshDerived();
+  return startStateCache_;
 }
 
 std::string core::TuringMachine::nextUniqueStateName() const
 {
+  refreshDerived();
   int index = 0;
-  std::set<std::string> existingNames;
-  for (const auto &state : states()) {
-    existingNames.insert(state.name());
-  }
   std::string name;
   do {
     name = "q" + std::to_string(index++);
-  } while (existingNames.count(name) > 0);
+  } while (stateIndex_.contains(name));
   return name;
 }
 
 void core::TuringMachine::addUnconnectedState(const State &st)
 {
+  touch();
   unconnectedStates_.push_back(st);
   if (st.isStart()) currentState_ = st;
 }
 
 void core::TuringMachine::removeState(State st)
 {
-  transitions_.erase(std::remove_if(transitions_.begin(), transitions_.end(),
-    [&st](const Transition &t) { return t.from() == st || t.to() == st; }), transitions_.end());
-  unconnectedStates_.erase(std::remove(unconnectedStates_.begin(), unconnectedStates_.end(), st), unconnectedStates_.end());
+  removeStates({ st });
+}
+
+void core::TuringMachine::addUnconnectedStates(const std::vector<State> &sts)
+{
+  touch();
+  unconnectedStates_.reserve(unconnectedStates_.size() + sts.size());
+  for (const auto &st : sts) {
+    unconnectedStates_.push_back(st);
+    if (st.isStart()) currentState_ = st;
+  }
+}
+
+void core::TuringMachine::removeStates(const std::vector<State> &sts)
+{
+  touch();
+  std::unordered_set<std::string> names;
+  names.reserve(sts.size());
+  std::vector<size_t> attached;
+  for (const auto &st : sts) {
+    names.insert(st.name());
+    if (auto it = adjacency_.find(st.name()); it != adjacency_.end()) {
+      attached.insert(attached.end(), it->second.out.begin(), it->second.out.end());
+      attached.insert(attached.end(), it->second.in.begin(), it->second.in.end());
+    }
+  }
+  // Back to front, so the last transition moved into a freed slot is never one still
+  // waiting to be removed.
+  std::sort(attached.begin(), attached.end(), std::greater<>());
+  attached.erase(std::unique(attached.begin(), attached.end()), attached.end());
+  for (size_t i : attached) {
+    eraseTransitionAt(i);
+  }
+  std::erase_if(unconnectedStates_, [&names](const State &st) { return names.contains(st.name()); });
   // TOTHINK: move any unconnected state to unconnectedStates_ after transition(s) removal.
 }
 
 bool core::TuringMachine::updateState(const State &o, const State &n)
 {
-  for (auto &t : transitions_) {
-    if (t.from() == o) t.setFrom(n);
-    if (t.to() == o) t.setTo(n);
+  touch();
+  if (auto node = adjacency_.extract(o.name())) {
+    for (size_t i : node.mapped().out) transitions_[i].setFrom(n);
+    for (size_t i : node.mapped().in) transitions_[i].setTo(n);
+    if (auto it = adjacency_.find(n.name()); it != adjacency_.end()) {
+      // Renamed onto an existing state: the two share their transitions from now on.
+      auto &adj = it->second;
+      adj.out.insert(adj.out.end(), node.mapped().out.begin(), node.mapped().out.end());
+      adj.in.insert(adj.in.end(), node.mapped().in.begin(), node.mapped().in.end());
+    } else {
+      node.key() = n.name();
+      adjacency_.insert(std::move(node));
+    }
   }
   for (auto &st : unconnectedStates_) {
     if (st == o) {
@@ -251,17 +722,112 @@ bool core::TuringMachine::updateState(const State &o, const State &n)
 
 bool core::TuringMachine::hasTransitionsFrom(State st) const
 {
-  for (const auto &t : transitions_) {
-    if (t.from() == st) {
-      return true;
-    }
+  return !transitionsFrom(st).empty();
+}
+
+const std::vector<size_t> &core::TuringMachine::transitionsFrom(const State &st) const
+{
+  static const std::vector<size_t> none;
+  auto it = adjacency_.find(st.name());
+  return it == adjacency_.end() ? none : it->second.out;
+}
+
+const std::vector<size_t> &core::TuringMachine::transitionsTo(const State &st) const
+{
+  static const std::vector<size_t> none;
+  auto it = adjacency_.find(st.name());
+  return it == adjacency_.end() ? none : it->second.in;
+}
+
+bool core::TuringMachine::hasTransition(const Transition &tr) const
+{
+  return transitionIndex(tr).has_value();
+}
+
+const core::Transition *core::TuringMachine::findTransition(const Transition &tr) const
+{
+  auto i = transitionIndex(tr);
+  return i ? &transitions_[*i] : nullptr;
+}
+
+std::optional<size_t> core::TuringMachine::transitionIndex(const Transition &tr) const
+{
+  if (tr.id()) {
+    auto it = idIndex_.find(tr.id());
+    if (it == idIndex_.end()) return std::nullopt;
+    return it->second;
+  }
+  for (size_t i : transitionsFrom(tr.from())) {
+    if (transitions_[i].sameContent(tr)) return i;
+  }
+  return std::nullopt;
+}
+
+void core::TuringMachine::indexTransition(size_t i)
+{
+  idIndex_[transitions_[i].id()] = i;
+  adjacency_[transitions_[i].from().name()].out.push_back(i);
+  adjacency_[transitions_[i].to().name()].in.push_back(i);
+}
+
+void core::TuringMachine::unindexTransition(size_t i)
+{
+  auto drop = [this](const State &st, std::vector<size_t> Adjacency::*list, size_t i) {
+    auto it = adjacency_.find(st.name());
+    if (it == adjacency_.end()) return;
+    auto &positions = it->second.*list;
+    positions.erase(std::find(positions.begin(), positions.end(), i));
+    if (it->second.out.empty() && it->second.in.empty()) adjacency_.erase(it);
+  };
+  drop(transitions_[i].from(), &Adjacency::out, i);
+  drop(transitions_[i].to(), &Adjacency::in, i);
+  idIndex_.erase(transitions_[i].id());
+}
+
+void core::TuringMachine::eraseTransitionAt(size_t i)
+{
+  unindexTransition(i);
+  const size_t last = transitions_.size() - 1;
+  if (i != last) {
+    // Keep the moved transition's place in its states' lists, so stepping still tries
+    // transitions in the order they were added.
+    auto &out = adjacency_[transitions_[last].from().name()].out;
+    *std::find(out.begin(), out.end(), last) = i;
+    auto &in = adjacency_[transitions_[last].to().name()].in;
+    *std::find(in.begin(), in.end(), last) = i;
+    idIndex_[transitions_[last].id()] = i;
+    transitions_[i] = std::move(transitions_[last]);
+  }
+  transitions_.pop_back();
+}
+
+void core::TuringMachine::rebuildAdjacency()
+{
+  adjacency_.clear();
+  idIndex_.clear();
+  for (size_t i = 0; i < transitions_.size(); i++) {
+    indexTransition(i);
   }
-  return false;
 }
 
 nlohmann::json core::TuringMachine::toJson() const
 {
   using nlohmann::json;
+  json j;
+  j["unconnectedStates"] = json::array();
+  for (const auto &st : unconnectedStates_) {
+    j["unconnectedStates"].push_back(stateToJson(st));
+  }
+  j["transitions"] = json::array();
+  for (const auto &tr : transitions_) {
+    j["transitions"].push_back(transitionToJson(tr));
+  }
+  if (auto symbols = symbols_.toJson(); !symbols.empty()) j["symbols"] = std::move(symbols);
+  return j;
+}
+
+nlohmann::json core::TuringMachine::stateToJson(const State &st)
+{
   auto stateTypeToStr = [](State::Type type) {
     switch (type) {
     case State::Type::START: return "START";
@@ -271,12 +837,14 @@ nlohmann::json core::TuringMachine::toJson() const
     }
     return "NORMAL";
     };
-  auto stateToJson = [stateTypeToStr](const State &st) {
-    return json{
-        {"name", st.name()},
-        {"type", stateTypeToStr(st.type())}
-    };
-    };
+  return nlohmann::json{
+      {"name", st.name()},
+      {"type", stateTypeToStr(st.type())}
+  };
+}
+
+nlohmann::json core::TuringMachine::transitionToJson(const Transition &tr)
+{
   auto dirToStr = [](Tape::Dir dir) {
     switch (dir) {
     case core::Tape::Dir::LEFT: return "LEFT";
@@ -284,25 +852,16 @@ nlohmann::json core::TuringMachine::toJson() const
     default: return "STAY";
     }
     };
-  json j;
-  j["unconnectedStates"] = json::array();
-  for (const auto &st : unconnectedStates_) {
-    j["unconnectedStates"].push_back(stateToJson(st));
-  }
-  j["transitions"] = json::array();
-  for (const auto &tr : transitions_) {
-    j["transitions"].push_back({
-        {"from", stateToJson(tr.from())},
-        {"readSymbol", std::string(1, tr.readSymbol())},
-        {"to", stateToJson(tr.to())},
-        {"writeSymbol", std::string(1, tr.writeSymbol())},
-        {"direction", dirToStr(tr.direction())}
-      });
-  }
-  return j;
+  return nlohmann::json{
+      {"from", stateToJson(tr.from())},
+      {"readSymbol", codesToUtf8(std::string_view(&tr.readSymbol_, 1))},
+      {"to", stateToJson(tr.to())},
+      {"writeSymbol", codesToUtf8(std::string_view(&tr.writeSymbol_, 1))},
+      {"direction", dirToStr(tr.direction())}
+  };
 }
 
-void core::TuringMachine::fromJson(const nlohmann::json &j)
+core::State core::TuringMachine::stateFromJson(const nlohmann::json &j)
 {
   auto strToStateType = [](const std::string &s) {
     if (s == "START") return State::Type::START;
@@ -310,47 +869,121 @@ void core::TuringMachine::fromJson(const nlohmann::json &j)
     if (s == "REJECT") return State::Type::REJECT;
     return State::Type::NORMAL;
     };
-  auto stateFromJson = [strToStateType](const nlohmann::json &j) {
-    return State(j.at("name").get<std::string>(), strToStateType(j.at("type").get<std::string>()));
-    };
+  return State(j.at("name").get<std::string>(), strToStateType(j.at("type").get<std::string>()));
+}
+
+core::Transition core::TuringMachine::transitionFromJson(const nlohmann::json &tr)
+{
   auto strToDir = [](const std::string &s) {
     if (s == "LEFT") return Tape::Dir::LEFT;
     if (s == "RIGHT") return Tape::Dir::RIGHT;
     return Tape::Dir::STAY;
     };
+  State from = stateFromJson(tr.at("from"));
+  char readSymbol = codesFromUtf8(tr.at("readSymbol").get<std::string>())[0];
+  State to = stateFromJson(tr.at("to"));
+  char writeSymbol = codesFromUtf8(tr.at("writeSymbol").get<std::string>())[0];
+  Tape::Dir dir = strToDir(tr.at("direction").get<std::string>());
+  return Transition(from, to, readSymbol, writeSymbol, dir);
+}
+
+void core::TuringMachine::fromJson(const nlohmann::json &j)
+{
+  touch();
   unconnectedStates_.clear();
   transitions_.clear();
+  symbols_ = {};
+  if (j.contains("symbols")) symbols_.fromJson(j["symbols"]);
   for (const auto &st : j.at("unconnectedStates")) {
     unconnectedStates_.push_back(stateFromJson(st));
   }
   for (const auto &tr : j.at("transitions")) {
-    State from = stateFromJson(tr.at("from"));
-    char readSymbol = tr.at("readSymbol").get<std::string>()[0];
-    State to = stateFromJson(tr.at("to"));
-    char writeSymbol = tr.at("writeSymbol").get<std::string>()[0];
-    Tape::Dir dir = strToDir(tr.at("direction").get<std::string>());
-    transitions_.emplace_back(from, to, readSymbol, writeSymbol, dir);
+    transitions_.push_back(transitionFromJson(tr));
+    transitions_.back().id_ = nextTransitionId_++;
   }
+  rebuildAdjacency();
 }
 
-void core::TuringMachine::addTransition(const Transition &tr)
+const core::Transition &core::TuringMachine::addTransition(const Transition &tr)
 {
+  touch();
   transitions_.push_back(tr);
+  transitions_.back().id_ = nextTransitionId_++;
+  indexTransition(transitions_.size() - 1);
+  return transitions_.back();
 }
 
 void core::TuringMachine::removeTransition(const Transition &tr)
 {
-  transitions_.erase(std::remove(transitions_.begin(), transitions_.end(), tr), transitions_.end());
+  removeTransitions({ tr });
 }
 
-void core::TuringMachine::updateTransition(const Transition &o, const Transition &n)
+void core::TuringMachine::addTransitions(const std::vector<Transition> &trs)
 {
-  auto it = std::find(transitions_.begin(), transitions_.end(), o);
-  if (it != transitions_.end()) {
-    *it = n;
+  touch();
+  transitions_.reserve(transitions_.size() + trs.size());
+  for (const auto &tr : trs) {
+    transitions_.push_back(tr);
+    transitions_.back().id_ = nextTransitionId_++;
+    indexTransition(transitions_.size() - 1);
   }
 }
 
+std::vector<uint32_t> core::TuringMachine::removeTransitions(const std::vector<Transition> &trs)
+{
+  touch();
+  std::vector<size_t> found;
+  found.reserve(trs.size());
+  for (const auto &tr : trs) {
+    if (tr.id()) {
+      if (auto i = transitionIndex(tr)) found.push_back(*i);
+      continue;
+    }
+    // Without an id every copy with the same content goes.
+    for (size_t i : transitionsFrom(tr.from())) {
+      if (transitions_[i].sameContent(tr)) found.push_back(i);
+    }
+  }
+  std::sort(found.begin(), found.end(), std::greater<>());
+  found.erase(std::unique(found.begin(), found.end()), found.end());
+  std::vector<uint32_t> ids;
+  ids.reserve(found.size());
+  for (size_t i : found) {
+    ids.push_back(transitions_[i].id());
+    eraseTransitionAt(i);
+  }
+  return ids;
+}
+
+void core::TuringMachine::updateTransition(const Transition &o, const Transition &n)
+{
+  touch();
+  auto i = transitionIndex(o);
+  if (!i) return;
+  auto &stored = transitions_[*i];
+  const uint32_t id = stored.id();
+  const bool moved = !(stored.from() == n.from() && stored.to() == n.to());
+  if (moved) unindexTransition(*i);
+  stored = n;
+  stored.id_ = id;
+  if (moved) indexTransition(*i);
+}
+
+
+//------------------------------------------------------------------------------------------
+
+
+void core::Breakpoints::clear()
+{
+  if (empty()) return;
+  states_.clear();
+  transitions_.clear();
+  steps_.clear();
+  cells_.clear();
+  watches_.clear();
+  revision_++;
+}
+
 
 //------------------------------------------------------------------------------------------
 
@@ -359,76 +992,237 @@ void core::MachineExecutor::start(core::TuringMachine &tm)
 {
   if (validateMachine(tm)) {
     if (state_ == ExecutionState::STOPPED) {
+      tm.packTape();
       stepCount_ = 0;
+      nextBudgetCheck_ = 0;
+      cancel_.reset();
+      watchHit_.reset();
       executionStartTime_ = std::chrono::steady_clock::now();
       totalExecutionTime_ = {};
       resetSpaceTracking();
-    } else if (state_ == ExecutionState::PAUSED) {
-      //executionStartTime_ = std::chrono::steady_clock::now();
+    } else {
+      // Resuming: the time spent stopped does not count, and a cancelled run may go on.
+      if (state_ == ExecutionState::CANCELLED) cancel_.reset();
+      if (state_ != ExecutionState::RUNNING) executionStartTime_ = std::chrono::steady_clock::now();
     }
-    state_ = ExecutionState::RUNNING;
+    setState(ExecutionState::RUNNING);
+    compiledRevision_ = UINT64_MAX;  // puts the watches back on the tape
+    unthrottled_ = false;
+    breakHit_ = Breakpoints::NONE;
+    tm.tape().takeWatchHit();
     lastStepTime_ = std::chrono::steady_clock::now();
   } else {
-    state_ = ExecutionState::ERROR;
+    setState(ExecutionState::ERROR);
   }
 }
 
+void core::MachineExecutor::setState(ExecutionState s)
+{
+  if (state_ == ExecutionState::RUNNING && s != ExecutionState::RUNNING) getElapsedTime();
+  state_ = s;
+}
+
+void core::MachineExecutor::runToBreakpoint(core::TuringMachine &tm)
+{
+  start(tm);
+  if (state_ == ExecutionState::RUNNING) unthrottled_ = true;
+}
+
 void core::MachineExecutor::pause()
 {
-  //if (state_ == ExecutionState::RUNNING) {
-  //  auto now = std::chrono::steady_clock::now();
-  //  totalExecutionTime_ += std::chrono::duration_cast<std::chrono::milliseconds>(now - executionStartTime_);
-  //}
-  state_ = ExecutionState::PAUSED;
+  setState(ExecutionState::PAUSED);
 }
 
 void core::MachineExecutor::stop(core::TuringMachine &tm)
 {
-  state_ = ExecutionState::STOPPED;
+  setState(ExecutionState::STOPPED);
+  breakHit_ = Breakpoints::NONE;
   resetMachine(tm);
+  removeWatches(tm);
 }
 
 void core::MachineExecutor::stepOnce(core::TuringMachine &tm)
 {
-  state_ = ExecutionState::STEP_MODE;
-  if (canStep(tm)) executeStep(tm);
+  if (state_ != ExecutionState::STEP_MODE) compiledRevision_ = UINT64_MAX;
+  if (state_ == ExecutionState::STOPPED || state_ == ExecutionState::CANCELLED) cancel_.reset();
+  setState(ExecutionState::STEP_MODE);
+  breakHit_ = Breakpoints::NONE;
+  compileBreakpoints(tm);
+  tm.tape().takeWatchHit();
+  if (canStep(tm) && withinBudget(tm)) executeStep(tm);
+  removeWatches(tm);
 }
 
 void core::MachineExecutor::update(core::TuringMachine &tm)
 {
-  bool currentlyRunning = (state_ == ExecutionState::RUNNING);
-  if (currentlyRunning) {
-    updateSpaceTracking(tm.tape());
-    auto now = std::chrono::steady_clock::now();
-    if (now - lastStepTime_ >= (stepDelay_ * (1.f / speedFactor_))) {
-      if (canStep(tm)) {
-        executeStep(tm);
-        lastStepTime_ = now;
-      } else {
-        state_ = tm.isAccepting() || tm.isRejecting()
-          ? ExecutionState::FINISHED
-          : ExecutionState::ERROR;
-      }
+  if (state_ != ExecutionState::RUNNING) return;
+  // Once per frame, so a slow run notices time running out or a cancellation even when
+  // no step is due.
+  if (!withinBudget(tm)) {
+    removeWatches(tm);
+    return;
+  }
+  compileBreakpoints(tm);
+  updateSpaceTracking(tm.tape());
+  const auto now = std::chrono::steady_clock::now();
+  const auto budget = std::chrono::milliseconds(10);
+  if (unthrottled_) {
+    // No step clock: run until the budget is spent, reading the clock every few hundred
+    // steps rather than after each one.
+    for (size_t n = 1; runStep(tm); n++) {
+      if (n % 256 == 0 && std::chrono::steady_clock::now() - now > budget) break;
+    }
+    lastStepTime_ = now;
+    removeWatches(tm);
+    return;
+  }
+  // Steps run on their own clock rather than one per frame: a late frame runs every step
+  // that came due since the last one, within a time budget so a stall cannot hang the UI.
+  const auto interval = stepInterval();
+  while (now - lastStepTime_ >= interval && runStep(tm)) {
+    lastStepTime_ += interval;
+    if (std::chrono::steady_clock::now() - now > budget) {
+      // Too far behind to catch up; drop the backlog.
+      lastStepTime_ = now;
+      break;
     }
   }
+  removeWatches(tm);
+}
+
+void core::MachineExecutor::removeWatches(core::TuringMachine &tm)
+{
+  switch (state_) {
+  case ExecutionState::RUNNING:
+  case ExecutionState::PAUSED:
+  case ExecutionState::STEP_MODE:
+    return;
+  default:
+    if (!tm.tape().watchpoints().empty()) tm.tape().setWatchpoints({});
+  }
+}
+
+std::optional<std::chrono::steady_clock::time_point> core::MachineExecutor::nextStepTime() const
+{
+  if (state_ != ExecutionState::RUNNING) return std::nullopt;
+  if (unthrottled_) return std::chrono::steady_clock::now();
+  return lastStepTime_ + stepInterval();
+}
+
+std::chrono::steady_clock::duration core::MachineExecutor::stepInterval() const
+{
+  return std::chrono::duration_cast<std::chrono::steady_clock::duration>(stepDelay_ * (1.f / speedFactor_));
 }
 
 bool core::MachineExecutor::canStep(const core::TuringMachine &tm) const
 {
-  return stepCount_ < maxSteps_
-    && !tm.isAccepting()
+  return !tm.isAccepting()
     && !tm.isRejecting()
     && state_ != ExecutionState::ERROR;
 }
 
-void core::MachineExecutor::executeStep(core::TuringMachine &tm)
+bool core::MachineExecutor::runStep(core::TuringMachine &tm)
+{
+  if (!canStep(tm)) {
+    setState(tm.isAccepting() || tm.isRejecting()
+      ? ExecutionState::FINISHED
+      : ExecutionState::ERROR);
+    return false;
+  }
+  if (stepCount_ >= nextBudgetCheck_ && !withinBudget(tm)) return false;
+  const bool hit = executeStep(tm);
+  updateSpaceTracking(tm.tape());
+  if (hit) setState(ExecutionState::PAUSED);
+  return state_ == ExecutionState::RUNNING;
+}
+
+bool core::MachineExecutor::withinBudget(const core::TuringMachine &tm)
+{
+  using Limit = ExecutionBudget::Limit;
+  exceeded_ = Limit::NONE;
+  if (cancel_.isCancelled()) {
+    setState(ExecutionState::CANCELLED);
+    return false;
+  }
+  if (budget_.steps && stepCount_ >= budget_.steps) {
+    exceeded_ = Limit::STEPS;
+  } else if (budget_.wallTime.count() && getElapsedTime() >= budget_.wallTime) {
+    exceeded_ = Limit::WALL_TIME;
+  } else if (budget_.tapeCells && tm.tape().getNonBlankCellCount() >= budget_.tapeCells) {
+    exceeded_ = Limit::TAPE_CELLS;
+  } else if (budget_.memoryBytes && tm.tape().memoryUsage() >= budget_.memoryBytes) {
+    exceeded_ = Limit::MEMORY;
+  }
+  if (exceeded_ != Limit::NONE) {
+    setState(ExecutionState::BUDGET_EXCEEDED);
+    return false;
+  }
+  nextBudgetCheck_ = stepCount_ + ExecutionBudget::CheckInterval;
+  if (budget_.steps) nextBudgetCheck_ = (std::min)(nextBudgetCheck_, budget_.steps);
+  return true;
+}
+
+bool core::MachineExecutor::executeStep(core::TuringMachine &tm)
 {
   try {
-    tm.step();
+    const int cell = tm.tape().head();
+    const bool moved = tm.step();
     stepCount_++;
+    if (onStep_) onStep_(StepEvent{ stepCount_, cell, tm.tape().readAt(cell), tm.tape().head() });
+    return armed_ && moved && checkBreakpoints(tm, cell);
   } catch (const std::exception &) {
-    state_ = ExecutionState::ERROR;
+    setState(ExecutionState::ERROR);
+    return false;
+  }
+}
+
+void core::MachineExecutor::compileBreakpoints(core::TuringMachine &tm)
+{
+  if (compiledGeneration_ == tm.generation() && compiledRevision_ == breakpoints_.revision()) return;
+  compiledGeneration_ = tm.generation();
+  compiledRevision_ = breakpoints_.revision();
+  transitionBreaks_.clear();
+  if (!breakpoints_.states().empty() || !breakpoints_.transitions().empty()) {
+    for (const auto &t : tm.transitions()) {
+      uint8_t kind = Breakpoints::NONE;
+      if (breakpoints_.hasTransition(t.id())) kind |= Breakpoints::TRANSITION;
+      if (breakpoints_.hasState(t.to().name())) kind |= Breakpoints::STATE;
+      if (kind == Breakpoints::NONE) continue;
+      if (t.id() >= transitionBreaks_.size()) transitionBreaks_.resize(t.id() + 1, Breakpoints::NONE);
+      transitionBreaks_[t.id()] = kind;
+    }
+  }
+  const auto &steps = breakpoints_.steps();
+  auto next = steps.upper_bound(stepCount_);
+  nextBreakStep_ = next != steps.end() ? *next : SIZE_MAX;
+  const auto &cells = breakpoints_.cells();
+  minBreakCell_ = cells.empty() ? 0 : *cells.begin();
+  maxBreakCell_ = cells.empty() ? -1 : *cells.rbegin();
+  // Installed on the tape even when empty, to drop watches of an earlier compile.
+  tm.tape().setWatchpoints(breakpoints_.watches());
+  armed_ = !transitionBreaks_.empty() || nextBreakStep_ != SIZE_MAX || !cells.empty() || !breakpoints_.watches().empty();
+}
+
+bool core::MachineExecutor::checkBreakpoints(core::TuringMachine &tm, int fromCell)
+{
+  uint8_t hit = Breakpoints::NONE;
+  const uint32_t id = tm.lastExecutedTransition();
+  if (id < transitionBreaks_.size()) hit |= transitionBreaks_[id];
+  if (stepCount_ == nextBreakStep_) {
+    hit |= Breakpoints::STEP;
+    auto next = breakpoints_.steps().upper_bound(stepCount_);
+    nextBreakStep_ = next != breakpoints_.steps().end() ? *next : SIZE_MAX;
+  }
+  const int head = tm.tape().head();
+  if (head != fromCell && head >= minBreakCell_ && head <= maxBreakCell_ && breakpoints_.hasCell(head)) {
+    hit |= Breakpoints::CELL;
+  }
+  if (auto w = tm.tape().takeWatchHit()) {
+    hit |= Breakpoints::WATCH;
+    watchHit_ = StepEvent{ stepCount_, w->first, w->second, head };
   }
+  breakHit_ = hit;
+  return hit != Breakpoints::NONE;
 }
 
 bool core::MachineExecutor::validateMachine(const core::TuringMachine &tm) const
@@ -459,11 +1253,10 @@ std::chrono::milliseconds core::MachineExecutor::getElapsedTime() const
 {
   if (state_ == ExecutionState::RUNNING) {
     auto now = std::chrono::steady_clock::now();
-    auto currentSession = std::chrono::duration_cast<std::chrono::milliseconds>(now - executionStartTime_);
-    totalExecutionTime_ += currentSession;
+    totalExecutionTime_ += now - executionStartTime_;
     executionStartTime_ = now;
   }
-  return totalExecutionTime_;
+  return std::chrono::duration_cast<std::chrono::milliseconds>(totalExecutionTime_);
 }
 
 std::string core::MachineExecutor::getFormattedTime() const
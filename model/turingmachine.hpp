@@ -1,12 +1,20 @@
 #pragma once
 
 #include <memory>
+#include <array>
 #include <set>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <chrono>
+#include <cstdint>
 #include <optional>
+#include <atomic>
+#include <functional>
+#include <utility>
+#include <bit>
 #include <nlohmann/json.hpp>
 
 
@@ -23,33 +31,200 @@ namespace core {
 
 
   class Tape {
-  private:
-    std::map<int, char> cells_;
-    int headPosition_ = 0;
-    mutable std::set<char> alphabet_;
   public:
-    static const char Blank = 0;
+    static constexpr char Blank = 0;
     enum class Dir { STAY, LEFT, RIGHT };
+    static constexpr int PageBits = 12;
+    static constexpr int PageSize = 1 << PageBits;
+
+    // Cells first..last watched for changes, optionally only changes to one symbol.
+    struct Watchpoint {
+      int first = 0;
+      int last = 0;
+      std::optional<char> symbol;
+    };
 
+  private:
+    // Cells live in fixed-size pages keyed by page number, so sparse tapes stay
+    // small while bulk reads and writes work on contiguous memory. A page packs its
+    // cells into words at bits_ per cell: the symbol itself at 8 bits, otherwise its
+    // index in palette_. Blank is always index 0, so a zeroed page is blank.
+    struct Page {
+      std::vector<uint64_t> words;
+      int filled = 0;                             // non-blank cells
+    };
+    static constexpr uint8_t NotInPalette = 0xFF;
+    std::map<int, Page> pages_;
+    int bits_ = 8;
+    std::array<char, 4> palette_{};
+    std::array<uint8_t, 256> paletteIndex_{};     // symbol -> index in palette_, unused at 8 bits
+    int headPosition_ = 0;
+    std::optional<std::pair<int, int>> extent_;   // lowest/highest index ever written
+    std::array<size_t, 256> symbolCounts_{};      // cells holding each symbol, blanks excluded
+    size_t nonBlank_ = 0;                         // sum of symbolCounts_
+    uint64_t version_ = 0;                        // bumped by every write
+    std::vector<Watchpoint> watches_;             // sorted by first cell
+    std::optional<std::pair<int, char>> watchHit_;
+
+    static int pageOf(int index) { return index >> PageBits; }
+    static int offsetOf(int index) { return index & (PageSize - 1); }
+    const Page *findPage(int page) const;
+    Page &pageAt(int page);
+    void growExtent(int first, int last);
+    void count(Page &page, char oldSymbol, char newSymbol);
+    void checkWatches(int index, char c);
+    char cellAt(const Page &page, int offset) const {
+      if (bits_ == 8) return reinterpret_cast<const char *>(page.words.data())[offset];
+      const int bit = offset * bits_;
+      return palette_[(page.words[bit >> 6] >> (bit & 63)) & ((1u << bits_) - 1)];
+    }
+    void setCell(Page &page, int offset, char c);
+    // Makes room in the palette for symbols, going wider (up to 8 bits) if needed.
+    void admit(const char *symbols, size_t n);
+    void repack(int bits, const std::vector<char> &palette);
+    // One bit set, at the cell's lowest bit, for every non-blank cell in w.
+    uint64_t nonBlankMask(uint64_t w) const {
+      switch (bits_) {
+      case 1: return w;
+      case 2: return (w | (w >> 1)) & 0x5555555555555555ull;
+      default: {
+        const uint64_t low7 = 0x7F7F7F7F7F7F7F7Full;
+        return ((((w & low7) + low7) | w) >> 7) & 0x0101010101010101ull;
+      }
+      }
+    }
+
+  public:
     int head() const { return headPosition_; }
-    char read() const { return cells_.contains(head()) ? cells_.at(head()) : Tape::Blank; }
+    void setHead(int pos) { headPosition_ = pos; }
+    char read() const { return readAt(head()); }
     void write(char symbol) { writeAt(head(), symbol); }
     void move(Dir dir);
     void moveLeft() { headPosition_ --; }
     void moveRight() { headPosition_ ++; }
-    void moveToLeftMost() { if (cells_.empty()) return; headPosition_ = cells_.begin()->first; }
-    void moveToRightMost() { if (cells_.empty()) return; headPosition_ = cells_.rbegin()->first; }
-    char readAt(int index) const { return cells_.contains(index) ? cells_.at(index) : Tape::Blank; }
+    void moveToLeftMost() { if (extent_) headPosition_ = extent_->first; }
+    void moveToRightMost() { if (extent_) headPosition_ = extent_->second; }
+    char readAt(int index) const;
     void writeAt(int index, char c);
+    // Bulk paths: copy n cells starting at `start` to/from a contiguous buffer.
+    void writeRange(int start, const char *data, size_t n);
+    void readRange(int start, char *out, size_t n) const;
+    void clear();
+    bool isEmpty() const { return !extent_.has_value(); }
     std::set<char> alphabet() const;
     nlohmann::json toJson() const;
     void fromJson(const nlohmann::json &j);
+    void cellFromJson(const nlohmann::json &item);
+    void segmentFromJson(const nlohmann::json &item);
     size_t getNonBlankCellCount() const;
     std::pair<int, int> getUsedRange() const;
+    // Changes whenever a cell is written; lets views cache what they derive from the cells.
+    uint64_t version() const { return version_; }
+    // Storage width: 1 or 2 bits per cell while the tape needs no more than 2 or 4 symbols
+    // (blank included), 8 otherwise. Writes outside the current symbols widen it.
+    int bitsPerCell() const { return bits_; }
+    // Packs as narrowly as the symbols already on the tape plus `symbols` allow.
+    void pack(const std::set<char> &symbols);
+    size_t memoryUsage() const;
+    // Writes that change a watched cell are recorded for takeWatchHit(). Only writes pay
+    // for this, and only a compare while nothing is watched.
+    void setWatchpoints(std::vector<Watchpoint> watches);
+    const std::vector<Watchpoint> &watchpoints() const { return watches_; }
+    // Cell and new symbol of the first watched change since the last call.
+    std::optional<std::pair<int, char>> takeWatchHit() { return std::exchange(watchHit_, std::nullopt); }
+
+    // Calls f(index, symbol) for every non-blank cell in ascending index order. Blank
+    // stretches are skipped a word at a time.
+    template <class F> void forEachNonBlank(F &&f) const {
+      const int bits = bits_;
+      const int cellsPerWord = 64 / bits;
+      const int bitsLog = std::countr_zero(unsigned(bits));
+      const unsigned cellMask = (1u << bits) - 1;
+      const auto palette = palette_;
+      for (const auto &[pageNo, page] : pages_) {
+        if (page.filled == 0) continue;
+        const int base = pageNo * PageSize;
+        for (size_t k = 0; k < page.words.size(); k ++) {
+          const uint64_t w = page.words[k];
+          for (uint64_t m = nonBlankMask(w); m; m &= m - 1) {
+            const int shift = std::countr_zero(m);
+            const unsigned cell = static_cast<unsigned>(w >> shift) & cellMask;
+            f(base + int(k) * cellsPerWord + (shift >> bitsLog), bits == 8 ? static_cast<char>(cell) : palette[cell]);
+          }
+        }
+      }
+    }
+
+    // Calls f(first, nonBlank) for every allocated page, covering cells [first, first + PageSize),
+    // in ascending order. Cheap way to see how cells are spread over a large tape.
+    template <class F> void forEachPage(F &&f) const {
+      for (const auto &[pageNo, page] : pages_) {
+        f(pageNo * PageSize, page.filled);
+      }
+    }
+
+    // Groups non-blank cells into segments, bridging gaps of up to maxGap blanks,
+    // and calls f(start, cells) with each segment's cells as a contiguous string.
+    template <class F> void forEachSegment(int maxGap, F &&f) const {
+      int start = 0;
+      int last = 0;
+      std::string cells;
+      forEachNonBlank([&](int index, char symbol) {
+        if (!cells.empty() && index - last > maxGap + 1) {
+          f(start, cells);
+          cells.clear();
+        }
+        if (cells.empty()) {
+          start = index;
+        } else {
+          cells.append(static_cast<size_t>(index - last - 1), Blank);
+        }
+        cells.push_back(symbol);
+        last = index;
+        });
+      if (!cells.empty()) f(start, cells);
+    }
   };
 
   std::string dirToStr(core::Tape::Dir d);
 
+  // Symbol codes as valid UTF-8, for json strings: codes 0x80-0xFF are written as
+  // U+0080-U+00FF, everything else as is.
+  std::string codesToUtf8(std::string_view codes);
+  std::string codesFromUtf8(std::string_view text);
+
+  // Names of the tape symbols. A symbol is one byte wherever the machine keeps it (tape
+  // cells, transitions), so the alphabet costs nothing per step. Printable ASCII
+  // characters stand for themselves; any other name ("X1", "#2", a Unicode arrow) is
+  // interned on first use into one of the codes left over.
+  class SymbolTable {
+  public:
+    SymbolTable();
+
+    // Code for name, interned if new; nullopt once every code is taken. "" is Tape::Blank.
+    std::optional<char> intern(const std::string &name);
+    std::optional<char> find(const std::string &name) const;
+    // Binds name to code, as read back from a file. False if either is already bound
+    // to something else.
+    bool define(const std::string &name, char code);
+    // "" for Tape::Blank and for codes nothing is interned in.
+    const std::string &name(char code) const { return names_[static_cast<unsigned char>(code)]; }
+    // Interned names only, in code order.
+    template <class F> void forEachInterned(F &&f) const {
+      for (int c = 0; c < 256; c ++) {
+        if (!isPlain(char(c)) && !names_[c].empty()) f(names_[c], char(c));
+      }
+    }
+    nlohmann::json toJson() const;
+    void fromJson(const nlohmann::json &j);
+
+  private:
+    static bool isPlain(char c) { return c >= 0x20 && c < 0x7f; }
+
+    std::array<std::string, 256> names_;
+    std::unordered_map<std::string, char> interned_;
+  };
+
   class State {
   public:
     enum class Type { TEMP, START, ACCEPT, REJECT, NORMAL };
@@ -79,13 +254,27 @@ namespace core {
     char readSymbol_;
     char writeSymbol_;
     Tape::Dir direction_;
+    uint32_t id_ = 0;
+    friend class TuringMachine;
     
   public:
     Transition(const State& from, const State &to, char readSymbol, char writeSymbol, Tape::Dir direction)
         : from_(from), readSymbol_(readSymbol), to_(to), writeSymbol_(writeSymbol), direction_(direction) {}
 
-    bool operator==(const Transition &rhs) const { return uniqueKey() == rhs.uniqueKey(); }
+    // Copies of a transition held by a machine compare by id, so they still match after
+    // being edited; a transition built elsewhere (a journal record, a file) by content.
+    bool operator==(const Transition &rhs) const {
+      if (id_ && rhs.id_) return id_ == rhs.id_;
+      return sameContent(rhs);
+    }
+    bool sameContent(const Transition &rhs) const {
+      return from_ == rhs.from_ && to_ == rhs.to_ && readSymbol_ == rhs.readSymbol_
+        && writeSymbol_ == rhs.writeSymbol_ && direction_ == rhs.direction_;
+    }
 
+    // Given by the machine when the transition is added and kept through edits; 0 until then.
+    uint32_t id() const { return id_; }
+    // Names the transition in saved files.
     std::string uniqueKey() const;
 
     // Getters
@@ -108,35 +297,94 @@ namespace core {
     TuringMachine();
 
     State currentState() const { return currentState_; }
-    std::string lastExecutedTransition() const { return lastExecutedTransition_; }
+    // Id of the transition taken by the last step; 0 if none.
+    uint32_t lastExecutedTransition() const { return lastExecutedTransition_; }
     const Tape &tape() const { return tape_; }
     Tape &tape() { return tape_; }
-    void step();
+    // Returns false if no transition applied and the machine halted.
+    bool step();
     void reset();
+    // Packs the tape as narrowly as its cells and every symbol a transition can write
+    // allow. Done on reset() and when a run starts.
+    void packTape();
     bool isAccepting() const;
     bool isRejecting() const;
-    std::vector<State> states() const;
+    const std::vector<State> &states() const;
+    std::optional<State> findState(const std::string &name) const;
+    std::optional<State> startState() const;
+    uint64_t generation() const { return generation_; }
+    // Removing a transition moves the last one into its place, so the order is the
+    // insertion order only until the first removal.
     const std::vector<Transition> &transitions() const { return transitions_; }
+    // Positions in transitions() of the transitions leaving / entering st, in the order
+    // they were added.
+    const std::vector<size_t> &transitionsFrom(const State &st) const;
+    const std::vector<size_t> &transitionsTo(const State &st) const;
+    bool hasTransition(const Transition &tr) const;
+    // The machine's copy of tr, matched by id if it has one and by content otherwise.
+    const Transition *findTransition(const Transition &tr) const;
     std::string nextUniqueStateName() const;
     void addUnconnectedState(const State &st);
     void removeState(State st);
     bool updateState(const State &o, const State &n);
     bool hasTransitionsFrom(State st) const;
-    void addTransition(const Transition &tr);
+    // Returns the stored copy, which carries the new id; valid until the next edit.
+    const Transition &addTransition(const Transition &tr);
     void removeTransition(const Transition &tr);
     void updateTransition(const Transition &o, const Transition &n);
+    // Bulk edits, one pass over the transitions however many states or transitions
+    // are affected. addTransitions appends to transitions(); removeTransitions returns
+    // the ids of the transitions it removed.
+    void addUnconnectedStates(const std::vector<State> &sts);
+    void removeStates(const std::vector<State> &sts);
+    void addTransitions(const std::vector<Transition> &trs);
+    std::vector<uint32_t> removeTransitions(const std::vector<Transition> &trs);
     std::vector<State> unconnectedStates() const { return unconnectedStates_; }
+    const SymbolTable &symbols() const { return symbols_; }
+    SymbolTable &symbols() { return symbols_; }
 
     nlohmann::json toJson() const;
     void fromJson(const nlohmann::json &j);
+    static nlohmann::json stateToJson(const State &st);
+    // Symbols are written as codes; names beyond ASCII live in the machine's "symbols".
+    static nlohmann::json transitionToJson(const Transition &tr);
+    static State stateFromJson(const nlohmann::json &j);
+    static Transition transitionFromJson(const nlohmann::json &j);
+
+  private:
+    void touch() { ++generation_; }
+    void refreshDerived() const;
+    std::optional<size_t> transitionIndex(const Transition &tr) const;
+    void indexTransition(size_t i);
+    void unindexTransition(size_t i);
+    void eraseTransitionAt(size_t i);
+    void rebuildAdjacency();
 
   private:
     std::vector<State> unconnectedStates_;
     std::vector<Transition> transitions_;
+    SymbolTable symbols_;
+    // Per state name, where its transitions sit in transitions_. Kept in step with every
+    // edit so stepping, renaming and deleting touch only the state's own transitions.
+    struct Adjacency {
+      std::vector<size_t> out;
+      std::vector<size_t> in;
+    };
+    std::unordered_map<std::string, Adjacency> adjacency_;
+    std::unordered_map<uint32_t, size_t> idIndex_;
+    uint32_t nextTransitionId_ = 1;
     State currentState_;
-    std::string lastExecutedTransition_;
+    uint32_t lastExecutedTransition_ = 0;
     Tape tape_;
     std::optional<Tape> tapeBackup_;
+
+    // Bumped by every structural mutation; derived views below are rebuilt lazily
+    // the first time they are read after the generation changes.
+    uint64_t generation_ = 0;
+    mutable uint64_t derivedGeneration_ = UINT64_MAX;
+    mutable std::vector<State> statesCache_;
+    mutable std::unordered_map<std::string, size_t> stateIndex_;
+    mutable std::optional<State> startStateCache_;
   };
 
 
@@ -146,11 +394,98 @@ namespace core {
     PAUSED,       // Execution suspended, can resume
     STEP_MODE,    // Manual step-by-step execution
     FINISHED,     // Reached accept/reject state
-    ERROR         // Invalid configuration or runtime error
+    ERROR,        // Invalid configuration or runtime error
+    BUDGET_EXCEEDED,  // Stopped by a limit of the ExecutionBudget, can resume once raised
+    CANCELLED     // Stopped through the CancellationToken
   };
 
   std::string executionStateToStr(ExecutionState s);
 
+  // One executed step as the tape saw it: the cell written and where the head went.
+  struct StepEvent {
+    size_t step;    // steps executed so far, this one included
+    int cell;
+    char symbol;
+    int head;
+  };
+
+  // Where a run pauses by itself: on entering a state, on taking a transition (by id), after
+  // a given step, when the head moves onto a cell, or when a watched cell changes.
+  class Breakpoints {
+  public:
+    enum Kind : uint8_t {
+      NONE = 0,
+      STATE = 1,
+      TRANSITION = 2,
+      STEP = 4,
+      CELL = 8,
+      WATCH = 16,
+    };
+
+    void setState(const std::string &name, bool on) { set(states_, name, on); }
+    void setTransition(uint32_t id, bool on) { set(transitions_, id, on); }
+    void setStep(size_t step, bool on) { set(steps_, step, on); }
+    void setCell(int cell, bool on) { set(cells_, cell, on); }
+    bool hasState(const std::string &name) const { return states_.contains(name); }
+    bool hasTransition(uint32_t id) const { return transitions_.contains(id); }
+    bool hasStep(size_t step) const { return steps_.contains(step); }
+    bool hasCell(int cell) const { return cells_.contains(cell); }
+    const std::set<std::string> &states() const { return states_; }
+    const std::set<uint32_t> &transitions() const { return transitions_; }
+    const std::set<size_t> &steps() const { return steps_; }
+    const std::set<int> &cells() const { return cells_; }
+    void addWatch(const Tape::Watchpoint &w) { watches_.push_back(w); revision_++; }
+    void removeWatch(size_t i) { watches_.erase(watches_.begin() + i); revision_++; }
+    const std::vector<Tape::Watchpoint> &watches() const { return watches_; }
+    bool empty() const {
+      return states_.empty() && transitions_.empty() && steps_.empty() && cells_.empty() && watches_.empty();
+    }
+    void clear();
+    // Changes whenever a breakpoint is set or cleared.
+    uint64_t revision() const { return revision_; }
+
+  private:
+    template <class T> void set(std::set<T> &s, const T &v, bool on) {
+      if (on ? s.insert(v).second : s.erase(v) > 0) revision_++;
+    }
+
+    std::set<std::string> states_;
+    std::set<uint32_t> transitions_;
+    std::set<size_t> steps_;
+    std::set<int> cells_;
+    std::vector<Tape::Watchpoint> watches_;
+    uint64_t revision_ = 0;
+  };
+
+
+  // Limits on a run; 0 means none. Apart from steps, they are checked every
+  // ExecutionBudget::CheckInterval steps and once per update().
+  struct ExecutionBudget {
+    static constexpr size_t CheckInterval = 1024;
+    enum class Limit { NONE, STEPS, WALL_TIME, TAPE_CELLS, MEMORY };
+
+    size_t steps = 10000;
+    std::chrono::milliseconds wallTime{ 0 };  // running time, as getElapsedTime() counts it
+    size_t tapeCells = 0;                     // non-blank cells
+    size_t memoryBytes = 0;                   // tape storage
+  };
+
+  std::string budgetLimitToStr(ExecutionBudget::Limit l);
+
+
+  // Stops a run from any thread. Copies share one flag; the executor looks at it with the
+  // other budget checks.
+  class CancellationToken {
+  public:
+    void cancel() const { flag_->store(true, std::memory_order_relaxed); }
+    bool isCancelled() const { return flag_->load(std::memory_order_relaxed); }
+    void reset() const { flag_->store(false, std::memory_order_relaxed); }
+
+  private:
+    std::shared_ptr<std::atomic<bool>> flag_ = std::make_shared<std::atomic<bool>>(false);
+  };
+
+
   class MachineExecutor {
   private:
     ExecutionState state_ = ExecutionState::STOPPED;
@@ -158,13 +493,32 @@ namespace core {
     float speedFactor_ = 1.f;
     std::chrono::steady_clock::time_point lastStepTime_;
     size_t stepCount_ = 0;
-    size_t maxSteps_ = 10000;
+    ExecutionBudget budget_;
+    CancellationToken cancel_;
+    size_t nextBudgetCheck_ = 0;              // step count at which the budget is checked next
+    ExecutionBudget::Limit exceeded_ = ExecutionBudget::Limit::NONE;
     mutable std::chrono::steady_clock::time_point executionStartTime_;
-    mutable std::chrono::milliseconds totalExecutionTime_{ 0 };
+    mutable std::chrono::steady_clock::duration totalExecutionTime_{ 0 };
     bool wasRunning_ = false;
     int minTapePosition_ = 0;
     int maxTapePosition_ = 0;
     size_t maxCellsUsed_ = 0;
+    std::function<void(const StepEvent &)> onStep_;
+    bool unthrottled_ = false;
+    Breakpoints breakpoints_;
+    // breakpoints_ compiled against the machine: a Breakpoints::Kind mask per transition id
+    // (state breakpoints mark every transition entering the state), the next step to stop
+    // after and the span of watched cells. armed_ is false when there is nothing to check,
+    // so a run without breakpoints pays one branch per step.
+    bool armed_ = false;
+    std::vector<uint8_t> transitionBreaks_;
+    size_t nextBreakStep_ = SIZE_MAX;
+    int minBreakCell_ = 0;
+    int maxBreakCell_ = -1;
+    uint64_t compiledGeneration_ = UINT64_MAX;
+    uint64_t compiledRevision_ = UINT64_MAX;
+    uint8_t breakHit_ = Breakpoints::NONE;
+    std::optional<StepEvent> watchHit_;
 
   public:
     void start(core::TuringMachine &tm);
@@ -172,18 +526,54 @@ namespace core {
     void stop(core::TuringMachine &tm);
     void stepOnce(core::TuringMachine &tm);
     void update(core::TuringMachine &tm);
+    // Like start(), but steps as fast as the frame budget allows instead of on the step
+    // clock, until a breakpoint, the end of the machine or pause().
+    void runToBreakpoint(core::TuringMachine &tm);
     ExecutionState state() const { return state_; }
     bool isRunning() const { return state_ == ExecutionState::RUNNING; }
     float speedFactor() const { return speedFactor_; }
     void setSpeedFactor(float f) { speedFactor_ = f; }
     size_t stepCount() const { return stepCount_; }
     size_t cellsUsed() const { return maxCellsUsed_; }
+    // When update() will next have a step to run; nullopt unless running.
+    std::optional<std::chrono::steady_clock::time_point> nextStepTime() const;
+    // Called after every executed step.
+    void setStepListener(std::function<void(const StepEvent &)> f) { onStep_ = std::move(f); }
     std::chrono::milliseconds getElapsedTime() const;
     std::string getFormattedTime() const;
+    Breakpoints &breakpoints() { return breakpoints_; }
+    const Breakpoints &breakpoints() const { return breakpoints_; }
+    // Applies from the next step on, also to a run in progress.
+    void setBudget(const ExecutionBudget &b) { budget_ = b; nextBudgetCheck_ = stepCount_; }
+    const ExecutionBudget &budget() const { return budget_; }
+    // The limit that stopped the run when the state is BUDGET_EXCEEDED.
+    ExecutionBudget::Limit exceededLimit() const { return exceeded_; }
+    // Cancels the current run. Starting a new run or resuming a cancelled one clears it.
+    const CancellationToken &cancellationToken() const { return cancel_; }
+    // Shares t's flag, so tokens handed out before keep working with this executor.
+    void setCancellationToken(const CancellationToken &t) { cancel_ = t; }
+    // Breakpoints::Kind mask of what the last step hit; NONE if it hit nothing.
+    uint8_t breakpointHit() const { return breakHit_; }
+    // The step that last changed a watched cell, and the cell and symbol it wrote.
+    const std::optional<StepEvent> &watchHit() const { return watchHit_; }
 
   private:
+    // Every state change goes through here: leaving RUNNING first adds the time run so
+    // far, since getElapsedTime() only counts while RUNNING.
+    void setState(ExecutionState s);
+    std::chrono::steady_clock::duration stepInterval() const;
     bool canStep(const core::TuringMachine &tm) const;
-    void executeStep(core::TuringMachine &tm);
+    // Sets BUDGET_EXCEEDED or CANCELLED and returns false if the run has to stop.
+    bool withinBudget(const core::TuringMachine &tm);
+    // One step of a run; false once the run finished, failed or paused at a breakpoint.
+    bool runStep(core::TuringMachine &tm);
+    // Returns true if the step hit a breakpoint.
+    bool executeStep(core::TuringMachine &tm);
+    void compileBreakpoints(core::TuringMachine &tm);
+    // Watches sit on the tape only while a run can go on, so writes between runs (edits,
+    // imports) keep the bulk paths. Takes them off once the run has ended.
+    void removeWatches(core::TuringMachine &tm);
+    bool checkBreakpoints(core::TuringMachine &tm, int fromCell);
     bool validateMachine(const core::TuringMachine &tm) const;
     void resetMachine(core::TuringMachine &tm) { tm.reset(); }
     void resetSpaceTracking();
@@ -0,0 +1,121 @@
+#ifndef _BINARYFORMAT_HPP_
+#define _BINARYFORMAT_HPP_
+
+#include <cstdint>
+#include <cstddef>
+#include <bit>
+
+// On-disk layout of the binary machine file (.tmb). All integers are little-endian,
+// every section starts on an 8-byte boundary and records are fixed size, so a mapped
+// file can be read in place without any tokenizing.
+//
+//   Header
+//   string table      state names, then symbol names, concatenated, not null terminated
+//   StateRecord[]     one per state, name referenced into the string table
+//   SymbolRecord[]    interned tape symbol names (version 2)
+//   TransitionRecord[]
+//   uint32_t[]        indices of unconnected states
+//   PositionRecord[]  canvas position per state (same order as StateRecord[])
+//   StyleRecord[]     visual style per transition (same order as TransitionRecord[])
+//   tape              TapeSegment headers, each followed by its payload
+
+namespace binfmt {
+
+  static_assert(std::endian::native == std::endian::little, "binary machine files assume a little-endian host");
+
+  constexpr char Magic[4] = { 'T', 'M', 'B', 'F' };
+  constexpr uint32_t Version = 2;
+  constexpr const char *Extension = ".tmb";
+
+  struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t stateCount;
+    uint32_t transitionCount;
+    uint32_t unconnectedCount;
+    uint32_t tapeSegmentCount;
+    int32_t headPosition;
+    uint32_t reserved;
+    uint64_t stringTableOffset;
+    uint64_t stringTableSize;
+    uint64_t statesOffset;
+    uint64_t transitionsOffset;
+    uint64_t unconnectedOffset;
+    uint64_t positionsOffset;   // 0 when absent
+    uint64_t stylesOffset;      // 0 when absent
+    uint64_t tapeOffset;
+    uint64_t tapeSize;
+    // Version 2
+    uint64_t symbolsOffset;
+    uint32_t symbolCount;
+    uint32_t pad;
+  };
+  // Version 1 headers end before symbolsOffset.
+  constexpr size_t HeaderSizeV1 = 104;
+
+  struct StateRecord {
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint8_t type;               // core::State::Type
+    uint8_t pad[3];
+  };
+
+  struct SymbolRecord {
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint8_t code;               // byte used for the symbol on the tape and in transitions
+    uint8_t pad[3];
+  };
+
+  struct TransitionRecord {
+    uint32_t from;              // index into StateRecord[]
+    uint32_t to;
+    uint8_t readSymbol;
+    uint8_t writeSymbol;
+    uint8_t direction;          // core::Tape::Dir
+    uint8_t pad;
+  };
+
+  struct PositionRecord {
+    float x, y;
+  };
+
+  struct StyleRecord {
+    float arcHeight;
+    float lineThickness;
+    float arrowSize;
+    uint32_t color;
+    uint32_t textColor;
+    int32_t transitionIndex;
+    float labelOffsetX;
+    float labelOffsetY;
+    uint8_t visible;
+    uint8_t labelManual;
+    uint8_t pad[2];
+  };
+
+  enum class TapeEncoding : uint32_t { RAW = 0, RLE = 1 };
+
+  // RAW payload: `length` bytes, one symbol per cell.
+  // RLE payload: (symbol byte, LEB128 run length) pairs covering `length` cells.
+  struct TapeSegment {
+    int32_t start;
+    uint32_t length;
+    TapeEncoding encoding;
+    uint32_t payloadSize;       // payload is padded to 4 bytes after this
+  };
+
+  static_assert(sizeof(Header) == 120);
+  static_assert(offsetof(Header, symbolsOffset) == HeaderSizeV1);
+  static_assert(sizeof(SymbolRecord) == 12);
+  static_assert(sizeof(StateRecord) == 12);
+  static_assert(sizeof(TransitionRecord) == 12);
+  static_assert(sizeof(StyleRecord) == 36);
+  static_assert(sizeof(TapeSegment) == 16);
+
+  inline size_t align8(size_t n) { return (n + 7) & ~size_t(7); }
+  inline size_t align4(size_t n) { return (n + 3) & ~size_t(3); }
+
+} // namespace binfmt
+
+#endif // _BINARYFORMAT_HPP_
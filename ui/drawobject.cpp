@@ -3,6 +3,7 @@
 #include "defs.hpp"
 #include "ui/manipulators.hpp"
 #include "model/turingmachine.hpp"
+#include <algorithm>
 #include <cmath>
 #include <format>
 #include <string>
@@ -15,8 +16,9 @@ namespace {
 } // anonymous namespace
 
 
-ui::StatePosHelperData ui::StatePosHelperData::calcEdges(const ImVec2 &fr, const ImVec2 &to)
+ui::StatePosHelperData ui::StatePosHelperData::calcEdges(const ImVec2 &fr, const ImVec2 &to, float zoom)
 {
+  const float radius = _stateRadius * zoom;
   StatePosHelperData res;
   ImVec2 dir = ImVec2(to.x - fr.x, to.y - fr.y);
   res.distance = std::sqrt(dir.x * dir.x + dir.y * dir.y);
@@ -28,24 +30,25 @@ ui::StatePosHelperData ui::StatePosHelperData::calcEdges(const ImVec2 &fr, const
   } else {
     dir.x /= res.distance;
     dir.y /= res.distance;
-    res.edgeFrom = ImVec2(fr.x + dir.x * _stateRadius, fr.y + dir.y * _stateRadius);
-    res.edgeTo = ImVec2(to.x - dir.x * _stateRadius, to.y - dir.y * _stateRadius);
+    res.edgeFrom = ImVec2(fr.x + dir.x * radius, fr.y + dir.y * radius);
+    res.edgeTo = ImVec2(to.x - dir.x * radius, to.y - dir.y * radius);
   }
   return res;
 }
 
-ui::StatePosHelperData ui::StatePosHelperData::calcEdgesSelfLink(const ImVec2 &pos, const ui::TransitionStyle &style)
+ui::StatePosHelperData ui::StatePosHelperData::calcEdgesSelfLink(const ImVec2 &pos, const ui::TransitionStyle &style, float zoom)
 {
+  const float radius = _stateRadius * zoom;
   StatePosHelperData res;
   const float angle = style.selfLinkRotationAngle * (style.transitionIndex * 60.0f) * (M_PI / 180.0f); // 60 degrees apart
   const float rate = 0.125f;
   res.edgeFrom = ImVec2(
-    pos.x + cosf(angle - M_PI * rate) * _stateRadius,
-    pos.y + sinf(angle - M_PI * rate) * _stateRadius
+    pos.x + cosf(angle - M_PI * rate) * radius,
+    pos.y + sinf(angle - M_PI * rate) * radius
   );
   res.edgeTo = ImVec2(
-    pos.x + cosf(angle + M_PI * rate) * _stateRadius,
-    pos.y + sinf(angle + M_PI * rate) * _stateRadius
+    pos.x + cosf(angle + M_PI * rate) * radius,
+    pos.y + sinf(angle + M_PI * rate) * radius
   );
   return res;
 }
@@ -88,7 +91,7 @@ ui::StateDrawObject::StateDrawObject(const core::State &state, AppState *app)
 
 void ui::StateDrawObject::draw(ImDrawList *) const
 {
-  ImVec2 pos = appState_->statePosition(state_);
+  ImVec2 pos = position();
   drawState(*appState_, state_, pos, Colors::black);
   ImVec2 mousePos = ImGui::GetMousePos();
   if (containsPoint(mousePos.x, mousePos.y) && ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left)) {
@@ -101,13 +104,23 @@ void ui::StateDrawObject::draw(ImDrawList *) const
 
 utils::Rect ui::StateDrawObject::boundingRect() const
 {
-  ImVec2 pos = appState_->statePosition(state_);
-  return utils::Rect{ pos.x - _stateRadius, pos.y - _stateRadius, _stateRadius * 2, _stateRadius * 2 };
+  ImVec2 pos = position();
+  const float r = _stateRadius * appState_->zoom();
+  return utils::Rect{ pos.x - r, pos.y - r, r * 2, r * 2 };
+}
+
+ImVec2 ui::StateDrawObject::position() const
+{
+  if (layoutVersion_ != appState_->layoutVersion()) {
+    layoutVersion_ = appState_->layoutVersion();
+    canvasPos_ = appState_->screenToCanvas(appState_->statePosition(state_));
+  }
+  return appState_->canvasToScreen(canvasPos_);
 }
 
 void ui::StateDrawObject::translate(const ImVec2 &delta)
 {
-  ImVec2 pos = appState_->statePosition(state_);
+  ImVec2 pos = position();
   appState_->setStatePosition(state_, pos + delta);
 }
 
@@ -124,6 +137,7 @@ ui::Manipulator *ui::StateDrawObject::getOrCreateManipulator(bool bCreate)
 void ui::StateDrawObject::drawState(AppState &appState, const core::State &state, ImVec2 pos, ImU32 clr, bool temp)
 {
   ImDrawList *dr = ImGui::GetWindowDrawList();
+  const float zoom = appState.zoom();
   ImU32 textClr = Colors::black;
   if (!temp) {
     auto  fill = Colors::royalBlue;
@@ -142,17 +156,30 @@ void ui::StateDrawObject::drawState(AppState &appState, const core::State &state
     } else {
       textClr = Colors::white;
     }
-    dr->AddCircleFilled(pos, _stateRadius, fill);
+    if (appState.isOverview()) {
+      // Overview: a plain dot, no outline, name or start marker.
+      dr->AddCircleFilled(pos, (std::max)(2.0f, _stateRadius * zoom), fill, 8);
+      return;
+    }
+    dr->AddCircleFilled(pos, _stateRadius * zoom, fill);
+  }
+  dr->AddCircle(pos, _stateRadius * zoom, clr, 64, 2.0f);
+  if (!temp && appState.breakpoints().hasState(state.name())) {
+    const float off = _stateRadius * 0.7f * zoom;
+    dr->AddCircleFilled(ImVec2(pos.x - off, pos.y - off), 5.0f * zoom, Colors::darkRed);
+  }
+  if (appState.showsText()) {
+    const float fontSize = ImGui::GetFontSize() * zoom;
+    ImVec2 sz = ImGui::CalcTextSize(state.name().c_str());
+    sz = ImVec2(sz.x * zoom, sz.y * zoom);
+    dr->AddText(ImGui::GetFont(), fontSize, ImVec2(pos.x - sz.x / 2, pos.y - sz.y / 2), textClr, state.name().c_str());
   }
-  dr->AddCircle(pos, _stateRadius, clr, 64, 2.0f);
-  ImVec2 sz = ImGui::CalcTextSize(state.name().c_str());
-  dr->AddText(ImVec2(pos.x - sz.x / 2, pos.y - sz.y / 2), textClr, state.name().c_str());
   if (state.isStart()) {
     // Draw a little arrow pointing to the state circle from the left side (arrow points to the right to the circle)
-    ImVec2 p1 = ImVec2(pos.x - _stateRadius - 20, pos.y);
-    ImVec2 p2 = ImVec2(pos.x - _stateRadius, pos.y);
+    ImVec2 p1 = ImVec2(pos.x - (_stateRadius + 20) * zoom, pos.y);
+    ImVec2 p2 = ImVec2(pos.x - _stateRadius * zoom, pos.y);
     dr->AddLine(p1, p2, Colors::black, 1.0f);
-    dr->AddTriangleFilled(ImVec2(p2.x - 10, p2.y - 5), ImVec2(p2.x, p2.y), ImVec2(p2.x - 10, p2.y + 5), Colors::black);
+    dr->AddTriangleFilled(ImVec2(p2.x - 10 * zoom, p2.y - 5 * zoom), ImVec2(p2.x, p2.y), ImVec2(p2.x - 10 * zoom, p2.y + 5 * zoom), Colors::black);
   }
 }
 
@@ -165,15 +192,19 @@ float ui::StateDrawObject::radius()
 //------------------------------------------------------------------------------------------
 
 
-ui::TransitionControlPoints ui::TransitionDrawObject::drawTransition(
-  AppState &appState, const core::Transition &trans, ImVec2 fromPos, ImVec2 toPos, const TransitionStyle &style)
+void ui::TransitionDrawObject::calcGeometry(Geometry &geom, ImVec2 fromPos, ImVec2 toPos, const TransitionStyle &style)
 {
-  ImDrawList *dr = ImGui::GetWindowDrawList();
-  TransitionControlPoints controlPoints;
+  geom.selfLoop = false;
+  geom.hasArrow = false;
+  geom.curve.clear();
+  geom.controlPoints = TransitionControlPoints{};
 
-  const auto [distance, edgeFrom, edgeTo] = StatePosHelperData::calcEdges(fromPos, toPos);
+  auto [distance, edgeFrom, edgeTo] = StatePosHelperData::calcEdges(fromPos, toPos);
   if (distance < 0.001f) {
-    return drawSelfLoop(appState, trans, fromPos, style);
+    auto res = StatePosHelperData::calcEdgesSelfLink(fromPos, style);
+    calcGeometry(geom, res.edgeFrom, res.edgeTo, style);
+    geom.selfLoop = true;
+    return;
   }
 
   // Handle multiple transitions between same states by offsetting the curve
@@ -192,69 +223,115 @@ ui::TransitionControlPoints ui::TransitionDrawObject::drawTransition(
   }
 
   ImVec2 control = ImVec2(mid.x + perp.x * arcOffset, mid.y + perp.y * arcOffset);
+  auto bezier = [&](float t) {
+    return ImVec2(
+      (1 - t) * (1 - t) * edgeFrom.x + 2 * (1 - t) * t * control.x + t * t * edgeTo.x,
+      (1 - t) * (1 - t) * edgeFrom.y + 2 * (1 - t) * t * control.y + t * t * edgeTo.y
+    );
+  };
 
-  // Calculate bezier midpoint (where label goes)
-  float t = 0.5f;
-  ImVec2 bezierMid = ImVec2(
-    (1 - t) * (1 - t) * edgeFrom.x + 2 * (1 - t) * t * control.x + t * t * edgeTo.x,
-    (1 - t) * (1 - t) * edgeFrom.y + 2 * (1 - t) * t * control.y + t * t * edgeTo.y
-  );
-
-  // Set control points BEFORE drawing
-  controlPoints.points[TransitionControlPoints::START] = edgeFrom;
-  controlPoints.points[TransitionControlPoints::MID] = bezierMid;
-  controlPoints.points[TransitionControlPoints::END] = edgeTo;
-  controlPoints.isValid = true;
-
-  //float lineThickness = style.lineThickness;
-  //auto lineColor = style.color;
-  auto colorHighlight = style.colorHighlight;
-  if (appState.tm().lastExecutedTransition() == trans.uniqueKey()) {
-    colorHighlight = Colors::cyan;
-    //lineThickness *= 2.0f; // Thicker line
-  }
-
-  // Draw quadratic Bezier arc from edge to edge
-  dr->AddBezierQuadratic(edgeFrom, control, edgeTo, style.color, style.lineThickness);
-  if (colorHighlight) {
-    dr->AddBezierQuadratic(edgeFrom, control, edgeTo, colorHighlight.value(), (style.lineThickness / 2.f));
+  // Bezier midpoint is where the label goes
+  geom.controlPoints.points[TransitionControlPoints::START] = edgeFrom;
+  geom.controlPoints.points[TransitionControlPoints::MID] = bezier(0.5f);
+  geom.controlPoints.points[TransitionControlPoints::END] = edgeTo;
+  geom.controlPoints.isValid = true;
+
+  // Tessellate once in canvas units; a segment every few units stays smooth when zoomed in.
+  const float hull = std::hypot(control.x - edgeFrom.x, control.y - edgeFrom.y) + std::hypot(edgeTo.x - control.x, edgeTo.y - control.y);
+  const int segments = std::clamp(static_cast<int>(hull / 6.0f), 8, 64);
+  geom.curve.reserve(segments + 1);
+  for (int i = 0; i <= segments; i++) {
+    geom.curve.push_back(bezier(static_cast<float>(i) / segments));
   }
 
-  // Draw arrowhead
-  drawArrowhead(edgeTo, control, style);
+  calcArrowhead(geom, edgeTo, control, style);
 
-  return controlPoints;
-}
-
-ui::TransitionControlPoints ui::TransitionDrawObject::drawSelfLoop(AppState &appState, const core::Transition &trans, ImVec2 pos, const TransitionStyle &style)
-{
-  auto res = StatePosHelperData::calcEdgesSelfLink(pos, style);
-  return drawTransition(appState, trans, res.edgeFrom, res.edgeTo, style);
+  float x0 = edgeFrom.x, y0 = edgeFrom.y, x1 = x0, y1 = y0;
+  auto grow = [&](const ImVec2 &p) {
+    x0 = (std::min)(x0, p.x);
+    y0 = (std::min)(y0, p.y);
+    x1 = (std::max)(x1, p.x);
+    y1 = (std::max)(y1, p.y);
+  };
+  for (const auto &p : geom.curve) grow(p);
+  if (geom.hasArrow) {
+    for (const auto &p : geom.arrow) grow(p);
+  }
+  geom.bounds = utils::Rect{ x0, y0, x1 - x0, y1 - y0 };
 }
 
-void ui::TransitionDrawObject::drawArrowhead(ImVec2 tipPos, ImVec2 controlPos, const TransitionStyle &style)
+void ui::TransitionDrawObject::calcArrowhead(Geometry &geom, ImVec2 tipPos, ImVec2 controlPos, const TransitionStyle &style)
 {
-  ImDrawList *dr = ImGui::GetWindowDrawList();
   // Compute direction at end of Bezier: tangent from control to tip
-  ImVec2 arrowDir = ImVec2(tipPos.x - controlPos.x, tipPos.y - controlPos.y);
-  float arrowDirLen = sqrtf(arrowDir.x * arrowDir.x + arrowDir.y * arrowDir.y);
-  if (arrowDirLen > 0.0f) {
-    arrowDir.x /= arrowDirLen;
-    arrowDir.y /= arrowDirLen;
-    drawArrowheadAtPoint(tipPos, arrowDir, style);
+  ImVec2 direction = ImVec2(tipPos.x - controlPos.x, tipPos.y - controlPos.y);
+  float directionLen = sqrtf(direction.x * direction.x + direction.y * direction.y);
+  if (directionLen <= 0.0f) {
+    return;
   }
-}
-
-void ui::TransitionDrawObject::drawArrowheadAtPoint(ImVec2 tipPos, ImVec2 direction, const TransitionStyle &style)
-{
-  ImDrawList *dr = ImGui::GetWindowDrawList();
+  direction.x /= directionLen;
+  direction.y /= directionLen;
   ImVec2 arrowPerp = ImVec2(-direction.y, direction.x);
   float halfSize = style.arrowSize * 0.5f;
-  ImVec2 arrowP1 = ImVec2(tipPos.x - direction.x * style.arrowSize + arrowPerp.x * halfSize,
+  geom.arrow[0] = tipPos;
+  geom.arrow[1] = ImVec2(tipPos.x - direction.x * style.arrowSize + arrowPerp.x * halfSize,
     tipPos.y - direction.y * style.arrowSize + arrowPerp.y * halfSize);
-  ImVec2 arrowP2 = ImVec2(tipPos.x - direction.x * style.arrowSize - arrowPerp.x * halfSize,
+  geom.arrow[2] = ImVec2(tipPos.x - direction.x * style.arrowSize - arrowPerp.x * halfSize,
     tipPos.y - direction.y * style.arrowSize - arrowPerp.y * halfSize);
-  dr->AddTriangleFilled(tipPos, arrowP1, arrowP2, style.color);
+  geom.hasArrow = true;
+}
+
+ui::TransitionControlPoints ui::TransitionDrawObject::drawTransition(AppState &appState, const core::Transition &trans,
+  const Geometry &geom, const TransitionStyle &style, std::vector<ImVec2> &scratch)
+{
+  ImDrawList *dr = ImGui::GetWindowDrawList();
+  TransitionControlPoints controlPoints;
+  if (!geom.controlPoints.isValid) {
+    return controlPoints;
+  }
+
+  // Canvas to screen is a scale plus an offset.
+  const float zoom = appState.zoom();
+  const ImVec2 origin = appState.canvasToScreen(ImVec2(0, 0));
+  auto toScreen = [&](const ImVec2 &p) { return ImVec2(origin.x + p.x * zoom, origin.y + p.y * zoom); };
+
+  const auto &cp = geom.controlPoints.points;
+  if (appState.isOverview()) {
+    // Overview: a plain segment between the states; self-loops are too small to show.
+    if (geom.selfLoop) {
+      return controlPoints;
+    }
+    const ImVec2 edgeFrom = toScreen(cp[TransitionControlPoints::START]);
+    const ImVec2 edgeTo = toScreen(cp[TransitionControlPoints::END]);
+    controlPoints.points[TransitionControlPoints::START] = edgeFrom;
+    controlPoints.points[TransitionControlPoints::MID] = ImVec2((edgeFrom.x + edgeTo.x) * 0.5f, (edgeFrom.y + edgeTo.y) * 0.5f);
+    controlPoints.points[TransitionControlPoints::END] = edgeTo;
+    controlPoints.isValid = true;
+    dr->AddLine(edgeFrom, edgeTo, style.colorHighlight.value_or(style.color), 1.0f);
+    return controlPoints;
+  }
+
+  for (int i = 0; i <= TransitionControlPoints::END; ++i) {
+    controlPoints.points[i] = toScreen(cp[i]);
+  }
+  controlPoints.isValid = true;
+
+  auto colorHighlight = style.colorHighlight;
+  if (trans.id() && appState.tm().lastExecutedTransition() == trans.id()) {
+    colorHighlight = Colors::cyan;
+  }
+
+  // Style sizes are canvas units
+  const float lineThickness = (std::max)(1.0f, style.lineThickness * zoom);
+  scratch.resize(geom.curve.size());
+  std::transform(geom.curve.begin(), geom.curve.end(), scratch.begin(), toScreen);
+  dr->AddPolyline(scratch.data(), static_cast<int>(scratch.size()), style.color, ImDrawFlags_None, lineThickness);
+  if (colorHighlight) {
+    dr->AddPolyline(scratch.data(), static_cast<int>(scratch.size()), colorHighlight.value(), ImDrawFlags_None, lineThickness / 2.f);
+  }
+  if (geom.hasArrow) {
+    dr->AddTriangleFilled(toScreen(geom.arrow[0]), toScreen(geom.arrow[1]), toScreen(geom.arrow[2]), style.color);
+  }
+  return controlPoints;
 }
 
 ui::TransitionDrawObject::TransitionDrawObject(const core::Transition &trans, AppState *app) 
@@ -265,20 +342,26 @@ ui::TransitionDrawObject::TransitionDrawObject(const core::Transition &trans, Ap
 void ui::TransitionDrawObject::draw(ImDrawList *dr) const
 {
   if (isVisible()) {
-    ImVec2 posFrom = appState_->statePosition(transition_.from());
-    ImVec2 posTo = appState_->statePosition(transition_.to());
     auto style{ style_ };
     if (manipulator_) {
       style.colorHighlight = Colors::red;
     }
-    controlPoints_ = drawTransition(*appState_, transition_, posFrom, posTo, style);
-    if (controlPoints_.isValid) {
+    controlPoints_ = drawTransition(*appState_, transition_, geometry(), style, screenCurve_);
+    if (controlPoints_.isValid && !appState_->isOverview()) {
       const float handleRadius = 4.0f;
       ImU32 handleColor = Colors::gray;
       dr->AddCircleFilled(controlPoints_.points[TransitionControlPoints::START], handleRadius, handleColor);
       dr->AddCircleFilled(controlPoints_.points[TransitionControlPoints::MID], handleRadius, handleColor);
       dr->AddCircleFilled(controlPoints_.points[TransitionControlPoints::END], handleRadius, handleColor);
     }
+    // Index the hit areas of containsPoint(), one box per control point.
+    const float hitRadius = 6.0f;
+    utils::Rect boxes[3];
+    for (int i = 0; i <= TransitionControlPoints::END; ++i) {
+      const auto &pt = controlPoints_.points[i];
+      boxes[i] = utils::Rect{ pt.x - hitRadius, pt.y - hitRadius, hitRadius * 2, hitRadius * 2 };
+    }
+    appState_->updateSpatialIndex(this, boxes, controlPoints_.isValid ? 3 : 0);
   }
 }
 
@@ -292,13 +375,59 @@ bool ui::TransitionDrawObject::containsPoint(float x, float y) const
 
 utils::Rect ui::TransitionDrawObject::boundingRect() const
 {
-  return utils::Rect();
+  // Box around the curve and arrowhead, grown by the line width and the labels.
+  const auto &geom = geometry();
+  const float zoom = appState_->zoom();
+  const auto rc = appState_->canvasToScreen(geom.bounds);
+  float pad = (std::max)(1.0f, style_.lineThickness * zoom);
+  float labelPad = 0;
+  for (auto *label : labels_) {
+    const ImVec2 off = label->manualOffset();
+    const auto rc = label->boundingRect();
+    labelPad = (std::max)(labelPad, (std::max)(std::fabs(off.x), std::fabs(off.y)) * zoom + (std::max)(rc.w, rc.h) * 0.5f + 2.0f);
+  }
+  pad += labelPad;
+  return utils::Rect{ rc.x - pad, rc.y - pad, rc.w + pad * 2, rc.h + pad * 2 };
 }
 
 void ui::TransitionDrawObject::translate(const ImVec2 &delta)
 {
 }
 
+std::pair<ImVec2, ImVec2> ui::TransitionDrawObject::endpointPositions() const
+{
+  auto &ep = endpoints_;
+  if (ep.layoutVersion != appState_->layoutVersion() || !(ep.from == transition_.from()) || !(ep.to == transition_.to())) {
+    ep.layoutVersion = appState_->layoutVersion();
+    ep.from = transition_.from();
+    ep.to = transition_.to();
+    ep.fromPos = appState_->screenToCanvas(appState_->statePosition(ep.from));
+    ep.toPos = appState_->screenToCanvas(appState_->statePosition(ep.to));
+  }
+  return { appState_->canvasToScreen(ep.fromPos), appState_->canvasToScreen(ep.toPos) };
+}
+
+const ui::TransitionDrawObject::Geometry &ui::TransitionDrawObject::geometry() const
+{
+  endpointPositions();
+  auto &geom = geometry_;
+  const auto &ep = endpoints_;
+  if (!geom.computed || geom.fromPos.x != ep.fromPos.x || geom.fromPos.y != ep.fromPos.y
+    || geom.toPos.x != ep.toPos.x || geom.toPos.y != ep.toPos.y
+    || geom.arcHeight != style_.arcHeight || geom.arrowSize != style_.arrowSize
+    || geom.selfLinkRotationAngle != style_.selfLinkRotationAngle || geom.transitionIndex != style_.transitionIndex) {
+    calcGeometry(geom, ep.fromPos, ep.toPos, style_);
+    geom.fromPos = ep.fromPos;
+    geom.toPos = ep.toPos;
+    geom.arcHeight = style_.arcHeight;
+    geom.arrowSize = style_.arrowSize;
+    geom.selfLinkRotationAngle = style_.selfLinkRotationAngle;
+    geom.transitionIndex = style_.transitionIndex;
+    geom.computed = true;
+  }
+  return geom;
+}
+
 ui::Manipulator *ui::TransitionDrawObject::getOrCreateManipulator(bool bCreate)
 {
   if (manipulator_) return manipulator_.get();
@@ -320,10 +449,15 @@ void ui::TransitionDrawObject::removeLabel(TransitionLabelDrawObject *label)
 }
 
 nlohmann::json ui::TransitionDrawObject::toJson() const
+{
+  return toJson(style_, isVisible());
+}
+
+nlohmann::json ui::TransitionDrawObject::toJson(const TransitionStyle &style, bool visible)
 {
   nlohmann::json j;
-  j["style"] = style_.toJson();
-  j["visible"] = isVisible();
+  j["style"] = style.toJson();
+  j["visible"] = visible;
   return j;
 }
 
@@ -352,7 +486,8 @@ ImVec2 ui::TransitionLabelDrawObject::getAutoPosition() const
 
 ImVec2 ui::TransitionLabelDrawObject::getFinalPosition() const
 {
-  return getAutoPosition() + manualOffset_;
+  const float zoom = appState_->zoom();
+  return getAutoPosition() + ImVec2(manualOffset_.x * zoom, manualOffset_.y * zoom);
 }
 
 void ui::TransitionLabelDrawObject::setManualOffset(const ImVec2 &offset)
@@ -369,28 +504,37 @@ void ui::TransitionLabelDrawObject::resetToAutoPosition()
 
 void ui::TransitionLabelDrawObject::draw(ImDrawList *dr) const
 {
-  float t = 0.5f;
+  if (!appState_->showsText() || !tdo_->controlPoints().isValid) {
+    // Too small to read at this zoom.
+    rect_ = {};
+    appState_->updateSpatialIndex(this, nullptr, 0);
+    return;
+  }
+  const float zoom = appState_->zoom();
   auto pos = getFinalPosition();
-  const auto &trans = tdo_->getTransition();
   const auto &style = tdo_->transitionStyle();
-  auto displayC = [](char c) { return c == core::Tape::Blank ? '-' : c; };
-  auto label = std::format("({}, {} ; {})", displayC(trans.readSymbol()), displayC(trans.writeSymbol()), core::dirToStr(trans.direction()));
-  ImVec2 textSize = ImGui::CalcTextSize(label.c_str());
+  const auto &text = this->text();
+  const auto &label = text.label;
+  ImVec2 textSize = ImVec2(text.size.x * zoom, text.size.y * zoom);
   ImVec2 labelPos = ImVec2(pos.x - textSize.x / 2, pos.y - textSize.y / 2);
   dr->AddRectFilled(ImVec2(labelPos.x - 2, labelPos.y - 1),
     ImVec2(labelPos.x + textSize.x + 2, labelPos.y + textSize.y + 1),
     IM_COL32(255, 255, 255, 200));
-  dr->AddText(labelPos, style.textColor, label.c_str());
+  dr->AddText(ImGui::GetFont(), ImGui::GetFontSize() * zoom, labelPos, style.textColor, label.c_str());
+  if (appState_->breakpoints().hasTransition(tdo_->getTransition().id())) {
+    dr->AddCircleFilled(ImVec2(labelPos.x - 8 * zoom, pos.y), 4.0f * zoom, Colors::darkRed);
+  }
   rect_.x = labelPos.x;
   rect_.y = labelPos.y;
   rect_.w = textSize.x;
   rect_.h = textSize.y;
+  appState_->updateSpatialIndex(this, &rect_, 1);
   ImVec2 mousePos = ImGui::GetMousePos();
   if (containsPoint(mousePos.x, mousePos.y) && ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left)) {
     auto p = const_cast<ui::TransitionDrawObject *>(tdo_);
     appState_->transitionLabelEditor().openEditor(p->getTransition(),
       [=](const core::Transition &tr){
-        appState_->tm().updateTransition(p->getTransition(), tr);
+        appState_->updateTransition(p->getTransition(), tr);
         p->getTransition().setDirection(tr.direction());
         p->getTransition().setReadSymbol(tr.readSymbol());
         p->getTransition().setWriteSymbol(tr.writeSymbol());
@@ -398,6 +542,23 @@ void ui::TransitionLabelDrawObject::draw(ImDrawList *dr) const
   }
 }
 
+const ui::TransitionLabelDrawObject::Text &ui::TransitionLabelDrawObject::text() const
+{
+  const auto &trans = tdo_->getTransition();
+  if (!text_.computed || text_.readSymbol != trans.readSymbol() || text_.writeSymbol != trans.writeSymbol()
+    || text_.direction != trans.direction()) {
+    const auto &symbols = appState_->tm().symbols();
+    auto display = [&](char c) { return c == core::Tape::Blank ? std::string("-") : symbols.name(c); };
+    text_.readSymbol = trans.readSymbol();
+    text_.writeSymbol = trans.writeSymbol();
+    text_.direction = trans.direction();
+    text_.label = std::format("({}, {} ; {})", display(text_.readSymbol), display(text_.writeSymbol), core::dirToStr(text_.direction));
+    text_.size = ImGui::CalcTextSize(text_.label.c_str());
+    text_.computed = true;
+  }
+  return text_;
+}
+
 utils::Rect ui::TransitionLabelDrawObject::boundingRect() const
 {
   return rect_;
@@ -405,12 +566,15 @@ utils::Rect ui::TransitionLabelDrawObject::boundingRect() const
 
 void ui::TransitionLabelDrawObject::translate(const ImVec2 &delta)
 {
+  // The offset is kept in canvas units.
+  const float zoom = appState_->zoom();
   if (!hasManualPosition_) {
     ImVec2 autoPos = getAutoPosition();
-    manualOffset_ = getFinalPosition() - autoPos;
+    ImVec2 d = getFinalPosition() - autoPos;
+    manualOffset_ = ImVec2(d.x / zoom, d.y / zoom);
     hasManualPosition_ = true;
   }
-  manualOffset_ += delta;
+  manualOffset_ += ImVec2(delta.x / zoom, delta.y / zoom);
 }
 
 ui::Manipulator *ui::TransitionLabelDrawObject::getOrCreateManipulator(bool bCreate)
@@ -424,10 +588,15 @@ ui::Manipulator *ui::TransitionLabelDrawObject::getOrCreateManipulator(bool bCre
 }
 
 nlohmann::json ui::TransitionLabelDrawObject::toJson() const
+{
+  return toJson(hasManualPosition_, manualOffset_);
+}
+
+nlohmann::json ui::TransitionLabelDrawObject::toJson(bool hasManualPosition, const ImVec2 &manualOffset)
 {
   nlohmann::json j;
-  j["hasManualPosition"] = hasManualPosition_;
-  j["manualOffset"] = { {"x", manualOffset_.x}, {"y", manualOffset_.y} };
+  j["hasManualPosition"] = hasManualPosition;
+  j["manualOffset"] = { {"x", manualOffset.x}, {"y", manualOffset.y} };
   return j;
 }
 
@@ -584,8 +753,9 @@ void ui::TransitionLabelEditor::openEditor(const core::Transition &trans, std::f
   onCommit_ = f;
   showDialog_ = true;
   transition_ = std::make_unique<core::Transition>(trans);
-  readSymbol_[0] = trans.readSymbol();
-  writeSymbol_[0] = trans.writeSymbol();
+  const auto &symbols = appState_.tm().symbols();
+  std::snprintf(readSymbol_, sizeof(readSymbol_), "%s", symbols.name(trans.readSymbol()).c_str());
+  std::snprintf(writeSymbol_, sizeof(writeSymbol_), "%s", symbols.name(trans.writeSymbol()).c_str());
   switch (trans.direction()) {
   case core::Tape::Dir::LEFT:
     direction_ = 0;
@@ -612,14 +782,14 @@ void ui::TransitionLabelEditor::render()
     ImGui::SameLine();
     ImGui::SetNextItemWidth(50);
     ImGui::PushStyleColor(ImGuiCol_Border, Colors::pastelGray);
-    ImGui::InputText("##read", readSymbol_, 2);
+    ImGui::InputText("##read", readSymbol_, sizeof(readSymbol_));
     ImGui::PopStyleColor();
 
     ImGui::Text("Write Symbol:");
     ImGui::SameLine();
     ImGui::SetNextItemWidth(50);
     ImGui::PushStyleColor(ImGuiCol_Border, Colors::pastelGray);
-    ImGui::InputText("##write", writeSymbol_, 2);
+    ImGui::InputText("##write", writeSymbol_, sizeof(writeSymbol_));
     ImGui::PopStyleColor();
 
     ImGui::Text("Direction:");
@@ -644,8 +814,9 @@ void ui::TransitionLabelEditor::render()
 
 void ui::TransitionLabelEditor::applyChanges()
 {
-  transition_->setReadSymbol(readSymbol_[0]);
-  transition_->setWriteSymbol(writeSymbol_[0]);
+  // A name that cannot be interned leaves that symbol as it was.
+  if (auto code = appState_.internSymbol(readSymbol_)) transition_->setReadSymbol(*code);
+  if (auto code = appState_.internSymbol(writeSymbol_)) transition_->setWriteSymbol(*code);
   switch (direction_) {
   case 0:
     transition_->setDirection(core::Tape::Dir::LEFT);
@@ -3,9 +3,14 @@
 
 #include "model/turingmachine.hpp"
 #include "defs.hpp"
+#include "ui/spatialindex.hpp"
 #include <memory>
+#include <cstdint>
+#include <utility>
 #include <optional>
 #include <functional>
+#include <string>
+#include <vector>
 #include <imgui.h>
 #include <nlohmann/json.hpp>
 
@@ -37,8 +42,9 @@ namespace ui {
     float distance = 0.0f;
     ImVec2 edgeFrom;
     ImVec2 edgeTo;
-    static StatePosHelperData calcEdges(const ImVec2 &fr, const ImVec2 &to);
-    static StatePosHelperData calcEdgesSelfLink(const ImVec2 &center, const ui::TransitionStyle &style);
+    // Positions are screen coordinates; zoom scales the state radius.
+    static StatePosHelperData calcEdges(const ImVec2 &fr, const ImVec2 &to, float zoom = 1.0f);
+    static StatePosHelperData calcEdgesSelfLink(const ImVec2 &center, const ui::TransitionStyle &style, float zoom = 1.0f);
   };
 
   struct TransitionControlPoints {
@@ -77,7 +83,7 @@ namespace ui {
   
     virtual ui::Manipulator *getOrCreateManipulator(bool bCreate) = 0;
     ui::Manipulator *createManipulator() { return getOrCreateManipulator(true); }
-    ui::Manipulator *getManipulator() const { return const_cast<DrawObject *>(this)->getOrCreateManipulator(false); }
+    ui::Manipulator *getManipulator() const { return manipulator_.get(); }
     void removeManipulator() { manipulator_.reset(); }
 
     virtual StateDrawObject *asState() { return nullptr; }
@@ -98,15 +104,21 @@ namespace ui {
     template <class T> const T *asType() const { return const_cast<DrawObject *>(this)->asType<T>(); }
 
     AppState *appState() const { return appState_; }
+    // Entry in AppState's spatial index, set while the object is indexed.
+    SpatialIndex::Handle indexHandle() const { return indexHandle_; }
+    void setIndexHandle(SpatialIndex::Handle h) { indexHandle_ = h; }
 
   protected:
     bool visible_ = true;
     AppState *appState_;
+    SpatialIndex::Handle indexHandle_ = nullptr;
     std::unique_ptr<Manipulator> manipulator_;
   };
 
-  class StateDrawObject : public DrawObject {
+  class StateDrawObject final : public DrawObject {
     core::State state_;
+    mutable uint64_t layoutVersion_ = 0;
+    mutable ImVec2 canvasPos_;
   public:
     StateDrawObject(const core::State &state, AppState *app);
     const core::State &getState() const { return state_; }
@@ -117,17 +129,49 @@ namespace ui {
     void translate(const ImVec2 &delta) override;
     ui::Manipulator *getOrCreateManipulator(bool bCreate) override;
     StateDrawObject *asState() override { return this; }
+    // Screen position of the state, cached until AppState's layout changes.
+    ImVec2 position() const;
 
   public:
     static void drawState(AppState &appState, const core::State &state, ImVec2 pos, ImU32 clr, bool temp = false);
     static float radius();
   };
 
-  class TransitionDrawObject : public DrawObject {
+  class TransitionDrawObject final : public DrawObject {
     friend class TransitionManipulator;
 
+    // Canvas positions of the two states, refreshed when the layout or the endpoints change.
+    struct Endpoints {
+      uint64_t layoutVersion = 0;
+      core::State from, to;
+      ImVec2 fromPos, toPos;
+    };
+
+  public:
+    // Curve, arrowhead and label anchor in canvas units. Everything scales with the view,
+    // so only moving a state or changing the style's shape invalidates it.
+    struct Geometry {
+      ImVec2 fromPos, toPos;              // canvas positions of the states
+      float arcHeight = 0.0f;
+      float arrowSize = 0.0f;
+      float selfLinkRotationAngle = 0.0f;
+      int transitionIndex = 0;
+      bool computed = false;
+
+      bool selfLoop = false;
+      TransitionControlPoints controlPoints;  // edge points and curve midpoint
+      std::vector<ImVec2> curve;              // tessellated Bezier, edge to edge
+      ImVec2 arrow[3];                        // tip first
+      bool hasArrow = false;
+      utils::Rect bounds;                     // curve and arrowhead
+    };
+
+  private:
     core::Transition transition_;
+    mutable Endpoints endpoints_;
+    mutable Geometry geometry_;
     mutable TransitionControlPoints controlPoints_;
+    mutable std::vector<ImVec2> screenCurve_;  // scratch for draw()
     TransitionStyle style_;
     std::vector<TransitionLabelDrawObject *> labels_; // weak references
   public:
@@ -144,36 +188,56 @@ namespace ui {
     void translate(const ImVec2 &delta) override;
     ui::Manipulator *getOrCreateManipulator(bool bCreate) override;
     TransitionDrawObject *asTransition() override { return this; }
+    // Screen positions of the from and to states.
+    std::pair<ImVec2, ImVec2> endpointPositions() const;
+    // Cached canvas geometry, recomputed when the states or the style have changed.
+    const Geometry &geometry() const;
 
     void addLabel(TransitionLabelDrawObject *label);
     void removeLabel(TransitionLabelDrawObject *label);
     const std::vector<TransitionLabelDrawObject *> &getLabels() const { return labels_; }
 
     nlohmann::json toJson() const;
+    // The same json from copied-out fields, for saves encoded off the UI thread.
+    static nlohmann::json toJson(const TransitionStyle &style, bool visible);
     void fromJson(const nlohmann::json &json);
 
   public:
-    static TransitionControlPoints drawTransition(
-      AppState &appState, const core::Transition &trans, ImVec2 posFrom, ImVec2 posTo, const TransitionStyle &style = TransitionStyle{});
+    // Geometry of a transition between states at canvas positions fromPos and toPos.
+    static void calcGeometry(Geometry &geom, ImVec2 fromPos, ImVec2 toPos, const TransitionStyle &style);
+    // Draws geom mapped to the screen; returns the screen control points.
+    static TransitionControlPoints drawTransition(AppState &appState, const core::Transition &trans,
+      const Geometry &geom, const TransitionStyle &style, std::vector<ImVec2> &scratch);
 
   private:
-    static TransitionControlPoints drawSelfLoop(AppState &appState, const core::Transition &trans, ImVec2 pos, const TransitionStyle &style);
-    static void drawArrowhead(ImVec2 tipPos, ImVec2 controlPos, const TransitionStyle &style);
-    static void drawArrowheadAtPoint(ImVec2 tipPos, ImVec2 direction, const TransitionStyle &style);
+    static void calcArrowhead(Geometry &geom, ImVec2 tipPos, ImVec2 controlPos, const TransitionStyle &style);
     //static void drawTransitionLabel(const core::Transition &trans, ImVec2 start, ImVec2 control, ImVec2 end, const TransitionStyle &style);
   };
 
-  class TransitionLabelDrawObject : public DrawObject {
+  class TransitionLabelDrawObject final : public DrawObject {
     const ui::TransitionDrawObject *tdo_;
     ImVec2 manualOffset_{ 0, 0 };
     bool hasManualPosition_ = false;
     mutable utils::Rect rect_;
+    // Label text and its unscaled size, rebuilt when the transition's symbols change.
+    struct Text {
+      char readSymbol = 0;
+      char writeSymbol = 0;
+      core::Tape::Dir direction = core::Tape::Dir::STAY;
+      bool computed = false;
+      std::string label;
+      ImVec2 size;
+    };
+    mutable Text text_;
+    const Text &text() const;
   public:
     TransitionLabelDrawObject(const ui::TransitionDrawObject *tdo, AppState *app);
     ImVec2 getAutoPosition() const;
     ImVec2 getFinalPosition() const;
     void setManualOffset(const ImVec2 &offset);
     void resetToAutoPosition();
+    ImVec2 manualOffset() const { return manualOffset_; }
+    bool hasManualPosition() const { return hasManualPosition_; }
 
     const ui::TransitionDrawObject *transitionDrawObject() const { return tdo_; }
 
@@ -184,11 +248,12 @@ namespace ui {
     TransitionLabelDrawObject *asTransitionLabel() override { return this; }
 
     nlohmann::json toJson() const;
+    static nlohmann::json toJson(bool hasManualPosition, const ImVec2 &manualOffset);
     void fromJson(const nlohmann::json &json);
 
   };
 
-  class SelectionDrawObject : public DrawObject {
+  class SelectionDrawObject final : public DrawObject {
     ImVec2 startPos_;
     ImVec2 endPos_;
   public:
@@ -224,8 +289,8 @@ namespace ui {
     AppState &appState_;
     bool showDialog_ = false;
     std::unique_ptr<core::Transition> transition_;
-    char readSymbol_[2] = "";
-    char writeSymbol_[2] = "";
+    char readSymbol_[20] = "";
+    char writeSymbol_[20] = "";
     int direction_ = 0;
     std::function<void(const core::Transition &)> onCommit_;
   public:
@@ -0,0 +1,130 @@
+#ifndef _DRAWOBJECTPOOL_HPP_
+#define _DRAWOBJECTPOOL_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace ui {
+
+  // Storage for the draw objects of one type. Objects sit in fixed-size blocks of
+  // contiguous slots, so walking a pool reads memory in order and calls the type's own
+  // (final) methods directly. Objects never move: the spatial index, manipulators and
+  // labels keep plain pointers to them. A slot belongs to its object for the object's
+  // lifetime; freed slots are reused by later objects, so slot order is creation order
+  // only until the first object is destroyed.
+  template <class T>
+  class DrawObjectPool {
+  public:
+    static constexpr size_t BlockSize = 256;
+
+    DrawObjectPool() = default;
+    ~DrawObjectPool() { clear(); }
+    DrawObjectPool(const DrawObjectPool &) = delete;
+    DrawObjectPool &operator=(const DrawObjectPool &) = delete;
+
+    template <class... Args>
+    T *create(Args &&...args) {
+      size_t slot;
+      if (!free_.empty()) {
+        slot = free_.back();
+        free_.pop_back();
+      } else {
+        slot = live_.size();
+        if (slot % BlockSize == 0) {
+          blocks_.emplace_back(new Block);
+          blockIndex_.emplace(blocks_.back()->data, blocks_.size() - 1);
+        }
+        live_.push_back(0);
+      }
+      T *obj;
+      try {
+        obj = new (address(slot)) T(std::forward<Args>(args)...);
+      } catch (...) {
+        free_.push_back(slot);
+        throw;
+      }
+      live_[slot] = 1;
+      count_++;
+      return obj;
+    }
+
+    void destroy(T *obj) {
+      const size_t slot = slotOf(obj);
+      if (slot == npos) return;
+      obj->~T();
+      live_[slot] = 0;
+      free_.push_back(slot);
+      count_--;
+    }
+
+    void clear() {
+      forEach([](T &obj) { obj.~T(); });
+      blocks_.clear();
+      blockIndex_.clear();
+      live_.clear();
+      free_.clear();
+      count_ = 0;
+    }
+
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+
+    // Slots run from 0 to slotCount() - 1; get() is null for a free slot.
+    size_t slotCount() const { return live_.size(); }
+    T *get(size_t slot) { return slot < live_.size() && live_[slot] ? address(slot) : nullptr; }
+    const T *get(size_t slot) const { return const_cast<DrawObjectPool *>(this)->get(slot); }
+    static constexpr size_t npos = size_t(-1);
+    size_t slotOf(const T *obj) const {
+      const auto *p = reinterpret_cast<const std::byte *>(obj);
+      // The block holding p is the one with the highest start address not above it.
+      auto it = blockIndex_.upper_bound(p);
+      if (it == blockIndex_.begin()) return npos;
+      --it;
+      if (!std::less<const std::byte *>()(p, it->first + sizeof(Block::data))) return npos;
+      return it->second * BlockSize + size_t(p - it->first) / sizeof(T);
+    }
+
+    // Calls f on every object, in slot order.
+    template <class F> void forEach(F &&f) {
+      for (size_t slot = 0; slot < live_.size(); slot++) {
+        if (live_[slot]) f(*address(slot));
+      }
+    }
+    template <class F> void forEach(F &&f) const {
+      for (size_t slot = 0; slot < live_.size(); slot++) {
+        if (live_[slot]) f(static_cast<const T &>(*const_cast<DrawObjectPool *>(this)->address(slot)));
+      }
+    }
+    // First object, in slot order, for which pred is true.
+    template <class Pred> T *find(Pred &&pred) {
+      for (size_t slot = 0; slot < live_.size(); slot++) {
+        if (live_[slot] && pred(*address(slot))) return address(slot);
+      }
+      return nullptr;
+    }
+
+  private:
+    struct Block {
+      alignas(T) std::byte data[BlockSize * sizeof(T)];
+    };
+
+    T *address(size_t slot) {
+      return std::launder(reinterpret_cast<T *>(blocks_[slot / BlockSize]->data + (slot % BlockSize) * sizeof(T)));
+    }
+
+    std::vector<std::unique_ptr<Block>> blocks_;
+    std::map<const std::byte *, size_t> blockIndex_;  // block start -> block number
+    std::vector<uint8_t> live_;
+    std::vector<size_t> free_;
+    size_t count_ = 0;
+  };
+
+}
+
+#endif // _DRAWOBJECTPOOL_HPP_
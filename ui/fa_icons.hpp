@@ -84,5 +84,7 @@
 #define ICON_FA_HDD (const char *)u8"\uf0a0"
 #define ICON_FA_CLOUD (const char *)u8"\uf0c2"
 #define ICON_FA_SERVER (const char *)u8"\uf233"
+#define ICON_FA_STREAM (const char *)u8"\uf550"
+#define ICON_FA_PROJECT_DIAGRAM (const char *)u8"\uf542"
 
 #endif
\ No newline at end of file
@@ -0,0 +1,39 @@
+#include "ui/framescheduler.hpp"
+#include <algorithm>
+
+
+namespace {
+  // ImGui reacts to some input a frame or two late (hover, popups opening, layout that
+  // depends on the previous frame), so input is followed by a few more frames.
+  constexpr int SettleFrames = 2;
+  // Timed waits may return this early; it still counts as reaching the deadline.
+  constexpr auto WakeSlack = std::chrono::milliseconds(2);
+} // anonymous namespace
+
+
+void ui::FrameScheduler::requestFrameAt(Clock::time_point t)
+{
+  deadline_ = deadline_ ? (std::min)(*deadline_, t) : t;
+}
+
+std::optional<double> ui::FrameScheduler::waitTimeout() const
+{
+  if (immediate_ || settleFrames_ > 0) return 0.0;
+  if (!deadline_) return std::nullopt;
+  const auto left = std::chrono::duration<double>(*deadline_ - Clock::now()).count();
+  return (std::max)(0.0, left);
+}
+
+void ui::FrameScheduler::wokeUp()
+{
+  const bool polled = immediate_ || settleFrames_ > 0;
+  const bool timedOut = deadline_ && Clock::now() + WakeSlack >= *deadline_;
+  if (!polled && !timedOut) {
+    // Nothing was due, so the wait ended on input.
+    settleFrames_ = SettleFrames;
+  } else if (settleFrames_ > 0) {
+    settleFrames_--;
+  }
+  immediate_ = false;
+  deadline_.reset();
+}
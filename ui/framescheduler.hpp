@@ -0,0 +1,36 @@
+#ifndef _FRAMESCHEDULER_HPP_
+#define _FRAMESCHEDULER_HPP_
+
+#include <chrono>
+#include <optional>
+
+namespace ui {
+
+  // Decides when the main loop renders. A frame is drawn when input arrives and at the
+  // deadlines the app asks for while drawing (the executor's next step, a status message
+  // running out); in between the loop sleeps in the window system's event wait.
+  // Deadlines only last one frame, so whoever needs a later frame asks again each frame.
+  class FrameScheduler {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    // Render the next frame without waiting.
+    void requestFrame() { immediate_ = true; }
+    // Render a frame no later than t.
+    void requestFrameAt(Clock::time_point t);
+    void requestFrameIn(Clock::duration d) { requestFrameAt(Clock::now() + d); }
+
+    // How long the main loop may wait for events, in seconds; nullopt to wait for input only.
+    std::optional<double> waitTimeout() const;
+    // Called when the wait returns, before the frame is built.
+    void wokeUp();
+
+  private:
+    std::optional<Clock::time_point> deadline_;
+    bool immediate_ = true;
+    int settleFrames_ = 0;
+  };
+
+}
+
+#endif // _FRAMESCHEDULER_HPP_
@@ -0,0 +1,358 @@
+#include "ui/journal.hpp"
+#include "ui/serializer.hpp"
+#include "model/turingmachine.hpp"
+#include "app.hpp"
+
+#include <nlohmann/json.hpp>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+
+using json = nlohmann::json;
+
+namespace {
+  constexpr int JournalVersion = 1;
+  // How long the writer lets records pile up before writing them out.
+  constexpr auto BatchDelay = std::chrono::milliseconds(200);
+  // Journal size after which compactIfDue() folds it into a new snapshot.
+  constexpr uint64_t CompactBytes = uint64_t(8) << 20;
+
+  bool syncStream(std::FILE *f) {
+    if (std::fflush(f) != 0) return false;
+#ifdef _WIN32
+    return _commit(_fileno(f)) == 0;
+#else
+    return fsync(fileno(f)) == 0;
+#endif
+  }
+
+  bool syncFile(const std::string &path) {
+    std::FILE *f = std::fopen(path.c_str(), "rb+");
+    if (!f) return false;
+    const bool ok = syncStream(f);
+    std::fclose(f);
+    return ok;
+  }
+
+  json posToJson(ImVec2 pos) {
+    return { {"x", pos.x}, {"y", pos.y} };
+  }
+
+  ImVec2 posFromJson(const json &j) {
+    return ImVec2{ j.at("x").get<float>(), j.at("y").get<float>() };
+  }
+
+  void applyRecord(const json &rec, AppState &appState) {
+    using TM = core::TuringMachine;
+    const auto &op = rec.at("op").get_ref<const std::string &>();
+    if (op == "addState") {
+      appState.addState(TM::stateFromJson(rec.at("state")), appState.canvasToScreen(posFromJson(rec.at("pos"))));
+    } else if (op == "removeState") {
+      appState.removeState(TM::stateFromJson(rec.at("state")));
+    } else if (op == "updateState") {
+      appState.updateState(TM::stateFromJson(rec.at("what")), TM::stateFromJson(rec.at("with")));
+    } else if (op == "moveState") {
+      appState.setStatePosition(TM::stateFromJson(rec.at("state")), appState.canvasToScreen(posFromJson(rec.at("pos"))));
+    } else if (op == "addTransition") {
+      appState.addTransition(TM::transitionFromJson(rec.at("transition")));
+    } else if (op == "removeTransition") {
+      appState.removeTransition(TM::transitionFromJson(rec.at("transition")));
+    } else if (op == "updateTransition") {
+      appState.updateTransition(TM::transitionFromJson(rec.at("what")), TM::transitionFromJson(rec.at("with")));
+    } else if (op == "writeTape") {
+      appState.writeTapeCell(rec.at("index").get<int>(), static_cast<char>(rec.at("symbol").get<int>()));
+    } else if (op == "addSymbol") {
+      const auto &name = rec.at("name").get_ref<const std::string &>();
+      if (!appState.tm().symbols().define(name, static_cast<char>(rec.at("code").get<int>()))) {
+        throw std::runtime_error("journal symbol '" + name + "' conflicts with the snapshot");
+      }
+    } else {
+      throw std::runtime_error("unknown journal record '" + op + "'");
+    }
+  }
+
+} // anonymous namespace
+
+
+EditJournal::EditJournal(const std::string &basePath)
+  : basePath_(basePath), journalPath_(basePath + ".journal")
+{
+  std::ifstream in(journalPath_, std::ios::binary);
+  std::string header;
+  if (in && std::getline(in, header)) {
+    json h = json::parse(header, nullptr, false);
+    if (!h.is_discarded()) epoch_ = h.value("epoch", uint64_t(0));
+  }
+  writer_ = std::thread(&EditJournal::run, this);
+}
+
+EditJournal::~EditJournal()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  if (writer_.joinable()) writer_.join();
+  if (file_) std::fclose(file_);
+}
+
+bool EditJournal::recover(AppState &appState)
+{
+  std::ifstream in(journalPath_, std::ios::binary);
+  std::string line;
+  if (!in || !std::getline(in, line)) return false;
+  if (epoch_ && !AppSerializer::loadFromFile(appState, snapshotPath(epoch_))) {
+    std::cerr << "Journal error: snapshot " << snapshotPath(epoch_) << " is unreadable" << std::endl;
+    return false;
+  }
+  size_t replayed = 0;
+  while (std::getline(in, line)) {
+    // A crash mid-write can leave a torn last line; everything before it is intact.
+    json rec = json::parse(line, nullptr, false);
+    if (rec.is_discarded()) break;
+    try {
+      applyRecord(rec, appState);
+    } catch (const std::exception &e) {
+      std::cerr << "Journal error: " << e.what() << std::endl;
+      break;
+    }
+    replayed++;
+  }
+  std::cout << "Recovered autosave: " << replayed << " edits replayed" << std::endl;
+  appState.setWindowTitle("Recovered autosave");
+  // Start the session from a clean snapshot rather than appending to the old journal.
+  compact(appState);
+  return true;
+}
+
+void EditJournal::addState(const core::State &state, ImVec2 pos)
+{
+  push(json{ {"op", "addState"}, {"state", core::TuringMachine::stateToJson(state)}, {"pos", posToJson(pos)} }.dump());
+}
+
+void EditJournal::removeState(const core::State &state)
+{
+  push(json{ {"op", "removeState"}, {"state", core::TuringMachine::stateToJson(state)} }.dump());
+}
+
+void EditJournal::updateState(const core::State &what, const core::State &with)
+{
+  push(json{ {"op", "updateState"}, {"what", core::TuringMachine::stateToJson(what)}, {"with", core::TuringMachine::stateToJson(with)} }.dump());
+}
+
+void EditJournal::moveState(const core::State &state, ImVec2 pos)
+{
+  std::string line = json{ {"op", "moveState"}, {"state", core::TuringMachine::stateToJson(state)}, {"pos", posToJson(pos)} }.dump();
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (stop_) return;
+  // Dragging moves a state every frame; a run of moves only needs its last position.
+  if (auto it = pendingMoves_.find(state.name()); it != pendingMoves_.end()) {
+    queue_[it->second].line = std::move(line);
+    return;
+  }
+  pendingMoves_.emplace(state.name(), queue_.size());
+  queue_.push_back(Item{ std::move(line), nullptr });
+  queued_++;
+  wake_.notify_one();
+}
+
+void EditJournal::addTransition(const core::Transition &trans)
+{
+  push(json{ {"op", "addTransition"}, {"transition", core::TuringMachine::transitionToJson(trans)} }.dump());
+}
+
+void EditJournal::removeTransition(const core::Transition &trans)
+{
+  push(json{ {"op", "removeTransition"}, {"transition", core::TuringMachine::transitionToJson(trans)} }.dump());
+}
+
+void EditJournal::updateTransition(const core::Transition &what, const core::Transition &with)
+{
+  push(json{ {"op", "updateTransition"}, {"what", core::TuringMachine::transitionToJson(what)}, {"with", core::TuringMachine::transitionToJson(with)} }.dump());
+}
+
+void EditJournal::writeTape(int index, char symbol)
+{
+  push(json{ {"op", "writeTape"}, {"index", index}, {"symbol", static_cast<int>(static_cast<unsigned char>(symbol))} }.dump());
+}
+
+void EditJournal::addSymbol(const std::string &name, char code)
+{
+  push(json{ {"op", "addSymbol"}, {"name", name}, {"code", static_cast<int>(static_cast<unsigned char>(code))} }.dump());
+}
+
+void EditJournal::compact(const AppState &appState)
+{
+  auto snapshot = std::make_shared<MachineSnapshot>(appState);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (stop_) return;
+  queue_.push_back(Item{ {}, std::move(snapshot) });
+  queued_++;
+  pendingMoves_.clear();
+  compacting_ = true;
+  wake_.notify_one();
+}
+
+void EditJournal::compactIfDue(const AppState &appState)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (compacting_ || journalBytes_ < CompactBytes) return;
+  }
+  compact(appState);
+}
+
+void EditJournal::flush()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  const uint64_t target = queued_;
+  flushRequested_ = true;
+  wake_.notify_one();
+  written_.wait(lock, [&] { return done_ >= target; });
+}
+
+void EditJournal::close()
+{
+  flush();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  writer_.join();
+  if (file_) {
+    std::fclose(file_);
+    file_ = nullptr;
+  }
+  // The journal goes first: without it the snapshot is never read.
+  std::error_code ec;
+  std::filesystem::remove(journalPath_, ec);
+  if (epoch_) std::filesystem::remove(snapshotPath(epoch_), ec);
+  epoch_ = 0;
+}
+
+void EditJournal::push(std::string &&line)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (stop_) return;
+  queue_.push_back(Item{ std::move(line), nullptr });
+  queued_++;
+  pendingMoves_.clear();
+  wake_.notify_one();
+}
+
+void EditJournal::run()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    wake_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+    if (queue_.empty()) break;
+    // Let a burst of edits (a drag, a tape clear) pile up so it costs one write and one fsync.
+    wake_.wait_for(lock, BatchDelay, [this] { return stop_ || flushRequested_; });
+    std::vector<Item> batch;
+    batch.swap(queue_);
+    pendingMoves_.clear();
+    flushRequested_ = false;
+    lock.unlock();
+    writeBatch(batch);
+    lock.lock();
+    done_ += batch.size();
+    written_.notify_all();
+  }
+}
+
+void EditJournal::writeBatch(std::vector<Item> &batch)
+{
+  std::string lines;
+  auto commit = [&] {
+    if (lines.empty()) return;
+    openJournal();
+    if (file_) {
+      std::fwrite(lines.data(), 1, lines.size(), file_);
+      if (!syncStream(file_)) std::cerr << "Journal error: failed writing " << journalPath_ << std::endl;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    journalBytes_ += lines.size();
+    lines.clear();
+    };
+  for (auto &item : batch) {
+    if (item.snapshot) {
+      commit();
+      rebase(*item.snapshot);
+    } else {
+      lines += item.line;
+      lines += '\n';
+    }
+  }
+  commit();
+}
+
+void EditJournal::openJournal()
+{
+  if (file_) return;
+  if (!std::filesystem::exists(journalPath_) && !writeHeader(epoch_)) return;
+  file_ = std::fopen(journalPath_.c_str(), "ab");
+  if (!file_) std::cerr << "Journal error: cannot open " << journalPath_ << std::endl;
+}
+
+// Replaces the journal with an empty one pointing at snapshot `epoch`.
+bool EditJournal::writeHeader(uint64_t epoch)
+{
+  const std::string partPath = journalPath_ + ".part";
+  std::FILE *f = std::fopen(partPath.c_str(), "wb");
+  if (!f) {
+    std::cerr << "Journal error: cannot open " << partPath << std::endl;
+    return false;
+  }
+  const std::string header = json{ {"version", JournalVersion}, {"epoch", epoch} }.dump() + "\n";
+  std::fwrite(header.data(), 1, header.size(), f);
+  const bool synced = syncStream(f);
+  std::fclose(f);
+  std::error_code ec;
+  if (synced) std::filesystem::rename(partPath, journalPath_, ec);
+  if (!synced || ec) {
+    std::cerr << "Journal error: failed writing " << journalPath_ << std::endl;
+    std::filesystem::remove(partPath, ec);
+    return false;
+  }
+  return true;
+}
+
+void EditJournal::rebase(const MachineSnapshot &snapshot)
+{
+  const uint64_t epoch = epoch_ + 1;
+  const std::string path = snapshotPath(epoch);
+  // The old journal stays authoritative until the new snapshot is durable.
+  if (snapshot.write(path) && syncFile(path)) {
+    if (file_) {
+      std::fclose(file_);
+      file_ = nullptr;
+    }
+    std::error_code ec;
+    if (writeHeader(epoch)) {
+      if (epoch_) std::filesystem::remove(snapshotPath(epoch_), ec);
+      epoch_ = epoch;
+      std::lock_guard<std::mutex> lock(mutex_);
+      journalBytes_ = 0;
+    } else {
+      std::filesystem::remove(path, ec);
+    }
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  compacting_ = false;
+}
+
+std::string EditJournal::snapshotPath(uint64_t epoch) const
+{
+  return basePath_ + "." + std::to_string(epoch) + ".tmb";
+}
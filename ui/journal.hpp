@@ -0,0 +1,93 @@
+#ifndef _JOURNAL_HPP_
+#define _JOURNAL_HPP_
+
+#include <imgui.h>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+
+class AppState;
+class MachineSnapshot;
+
+namespace core {
+  class State;
+  class Transition;
+}
+
+// Crash-safe autosave. Model edits made through AppState are appended, one json line
+// each, to <base>.journal by a background writer that batches lines and pays for one
+// fsync per batch. The first line of the journal names the full snapshot it applies to
+// (<base>.<epoch>.tmb); compaction writes a new snapshot and swaps in a fresh journal,
+// so a crash at any point leaves a consistent snapshot + journal pair on disk.
+class EditJournal {
+public:
+  explicit EditJournal(const std::string &basePath);
+  ~EditJournal();
+  EditJournal(const EditJournal &) = delete;
+  EditJournal &operator=(const EditJournal &) = delete;
+
+  // Loads the last snapshot and replays the journal on top of it. Call before the
+  // journal is attached to appState. Returns false if there was nothing to recover.
+  bool recover(AppState &appState);
+
+  // Positions are canvas coordinates.
+  void addState(const core::State &state, ImVec2 pos);
+  void removeState(const core::State &state);
+  void updateState(const core::State &what, const core::State &with);
+  void moveState(const core::State &state, ImVec2 pos);
+  void addTransition(const core::Transition &trans);
+  void removeTransition(const core::Transition &trans);
+  void updateTransition(const core::Transition &what, const core::Transition &with);
+  void writeTape(int index, char symbol);
+  void addSymbol(const std::string &name, char code);
+
+  // Re-bases the journal on a full snapshot of appState, written in the background.
+  void compact(const AppState &appState);
+  // Compacts once the journal has grown past a size threshold.
+  void compactIfDue(const AppState &appState);
+  // Blocks until every record queued so far is on disk.
+  void flush();
+  // Clean shutdown: stops recording and deletes the journal and its snapshot, so the
+  // next start only recovers after a session that did not get here.
+  void close();
+
+private:
+  struct Item {
+    std::string line;
+    std::shared_ptr<MachineSnapshot> snapshot;  // set for compaction items
+  };
+
+  void push(std::string &&line);
+  void run();
+  void writeBatch(std::vector<Item> &batch);
+  void openJournal();
+  bool writeHeader(uint64_t epoch);
+  void rebase(const MachineSnapshot &snapshot);
+  std::string snapshotPath(uint64_t epoch) const;
+
+  std::string basePath_;
+  std::string journalPath_;
+  std::FILE *file_ = nullptr;          // writer thread only
+  uint64_t epoch_ = 0;                 // 0 until the first snapshot; writer thread only after construction
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable written_;
+  std::vector<Item> queue_;
+  std::unordered_map<std::string, size_t> pendingMoves_;  // state name -> index in queue_
+  uint64_t queued_ = 0;
+  uint64_t done_ = 0;
+  uint64_t journalBytes_ = 0;
+  bool compacting_ = false;
+  bool flushRequested_ = false;
+  bool stop_ = false;
+  std::thread writer_;
+};
+
+#endif // _JOURNAL_HPP_
@@ -0,0 +1,585 @@
+#include "ui/layout.hpp"
+#include "app.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <random>
+
+
+namespace {
+  // Preferred distance between connected states, in canvas units.
+  constexpr float IdealEdge = 150.0f;
+  // Relative strength of the repulsion; with it the springs settle at about IdealEdge.
+  constexpr float Repulsion = 0.2f;
+  // Pull towards the centroid that keeps unconnected parts from drifting apart.
+  constexpr float Gravity = 0.02f;
+  // A quadtree cell this much smaller than its distance acts as one body.
+  constexpr float Theta = 0.9f;
+  constexpr int MaxIterations = 1000;
+  // The simulation stops once states move less than this fraction of the natural length
+  // per iteration.
+  constexpr float Tolerance = 0.01f;
+  // Coarsening stops at this many nodes; later levels start with this fraction of the
+  // natural length as their step, their layout being roughly right already.
+  constexpr size_t CoarsestSize = 32;
+  constexpr float RefineStep = 0.3f;
+  // Columns and rows of the layered layout.
+  constexpr float LayerSpacing = 200.0f;
+  constexpr float RowSpacing = 120.0f;
+  constexpr int OrderingSweeps = 12;
+  // Top-left corner of a complete layout.
+  constexpr float Margin = 100.0f;
+  constexpr auto PublishInterval = std::chrono::milliseconds(30);
+
+  // Distance at which spring and repulsion balance for a lone pair; chosen so that
+  // connected states end up about IdealEdge apart.
+  const float NaturalLength = IdealEdge / std::sqrt(std::sqrt(Repulsion));
+
+  using Adjacency = std::vector<std::vector<int>>;
+
+  // Barnes-Hut quadtree: a group of states far enough away repels as one body at its
+  // centre of mass, making an iteration O(n log n) instead of O(n^2).
+  class QuadTree {
+  public:
+    void build(const std::vector<ImVec2> &pos) {
+      float x0 = pos[0].x, y0 = pos[0].y, x1 = x0, y1 = y0;
+      for (const auto &p : pos) {
+        x0 = (std::min)(x0, p.x); y0 = (std::min)(y0, p.y);
+        x1 = (std::max)(x1, p.x); y1 = (std::max)(y1, p.y);
+      }
+      nodes_.clear();
+      nodes_.push_back(Node{ x0, y0, (std::max)(x1 - x0, y1 - y0) + 1.0f });
+      for (int i = 0; i < int(pos.size()); i++) insert(pos, i);
+    }
+
+    // Sum over all other bodies of strength / d^2, pointing away from them.
+    ImVec2 repulsion(const std::vector<ImVec2> &pos, int body, float strength) {
+      const ImVec2 p = pos[body];
+      ImVec2 f;
+      stack_.assign(1, 0);
+      while (!stack_.empty()) {
+        const Node &n = nodes_[stack_.back()];
+        stack_.pop_back();
+        if (n.mass == 0 || n.body == body) continue;
+        float dx = p.x - n.cx, dy = p.y - n.cy;
+        float d2 = dx * dx + dy * dy;
+        if (n.child >= 0 && n.size * n.size >= Theta * Theta * d2) {
+          for (int k = 0; k < 4; k++) stack_.push_back(n.child + k);
+          continue;
+        }
+        if (d2 < 1e-4f) {
+          // Coincident states: push each one in its own direction.
+          const float a = float(body) * 2.39996f;
+          dx = std::cos(a);
+          dy = std::sin(a);
+          d2 = 1.0f;
+        }
+        const float w = strength * float(n.mass) / (d2 * std::sqrt(d2));
+        f.x += dx * w;
+        f.y += dy * w;
+      }
+      return f;
+    }
+
+  private:
+    static constexpr int MaxDepth = 24;
+
+    struct Node {
+      float x, y, size;      // square covered
+      float cx = 0, cy = 0;  // centre of mass
+      int mass = 0;
+      int child = -1;        // first of the four children, -1 for a leaf
+      int body = -1;         // the body of a leaf holding exactly one
+    };
+
+    static int quadrant(const Node &n, ImVec2 p) {
+      const float half = n.size * 0.5f;
+      return (p.x >= n.x + half ? 1 : 0) | (p.y >= n.y + half ? 2 : 0);
+    }
+
+    void insert(const std::vector<ImVec2> &pos, int body) {
+      const ImVec2 p = pos[body];
+      int ni = 0;
+      for (int depth = 0;; depth++) {
+        Node &n = nodes_[ni];
+        n.cx = (n.cx * n.mass + p.x) / float(n.mass + 1);
+        n.cy = (n.cy * n.mass + p.y) / float(n.mass + 1);
+        n.mass++;
+        if (n.child < 0) {
+          if (n.mass == 1) {
+            n.body = body;
+            return;
+          }
+          if (depth == MaxDepth) {
+            // Bodies this close share the leaf.
+            n.body = -1;
+            return;
+          }
+          const int resident = n.body;
+          const Node parent = n;
+          const float half = parent.size * 0.5f;
+          const int first = int(nodes_.size());
+          nodes_[ni].child = first;
+          nodes_[ni].body = -1;
+          for (int k = 0; k < 4; k++) {
+            nodes_.push_back(Node{ parent.x + (k & 1) * half, parent.y + (k >> 1) * half, half });
+          }
+          if (resident >= 0) {
+            Node &c = nodes_[first + quadrant(parent, pos[resident])];
+            c.cx = pos[resident].x;
+            c.cy = pos[resident].y;
+            c.mass = 1;
+            c.body = resident;
+          }
+        }
+        ni = nodes_[ni].child + quadrant(nodes_[ni], p);
+      }
+    }
+
+    std::vector<Node> nodes_;
+    std::vector<int> stack_;
+  };
+
+  // Runs the force simulation on pos until it settles, starting with the given step.
+  // States with movable[i] == 0 stay put; a null movable moves all of them. report(progress)
+  // is called once per iteration and stops the simulation by returning false.
+  template <class Report>
+  bool relax(const Adjacency &adjacent, std::vector<ImVec2> &pos, const std::vector<char> *movable, float step, Report report) {
+    const int n = int(pos.size());
+    const float k = NaturalLength;
+    const float strength = Repulsion * k * k * k;
+    const float startStep = step;
+    QuadTree tree;
+    std::vector<ImVec2> force(n);
+    float lastEnergy = INFINITY, progress = 0;
+    int improving = 0;
+    for (int iter = 0; iter < MaxIterations; iter++) {
+      tree.build(pos);
+      ImVec2 c;
+      for (const auto &p : pos) {
+        c.x += p.x;
+        c.y += p.y;
+      }
+      c = ImVec2(c.x / n, c.y / n);
+      float energy = 0;
+      for (int i = 0; i < n; i++) {
+        if (movable && !(*movable)[i]) continue;
+        ImVec2 f = tree.repulsion(pos, i, strength);
+        for (int j : adjacent[i]) {
+          const float dx = pos[j].x - pos[i].x, dy = pos[j].y - pos[i].y;
+          const float w = std::sqrt(dx * dx + dy * dy) / k;
+          f.x += dx * w;
+          f.y += dy * w;
+        }
+        f.x += (c.x - pos[i].x) * Gravity;
+        f.y += (c.y - pos[i].y) * Gravity;
+        force[i] = f;
+        energy += f.x * f.x + f.y * f.y;
+      }
+      for (int i = 0; i < n; i++) {
+        if (movable && !(*movable)[i]) continue;
+        const float len = std::sqrt(force[i].x * force[i].x + force[i].y * force[i].y);
+        if (len > 0) {
+          pos[i].x += force[i].x / len * step;
+          pos[i].y += force[i].y / len * step;
+        }
+      }
+      if (energy < lastEnergy) {
+        if (++improving >= 5) {
+          improving = 0;
+          step /= 0.9f;
+        }
+      } else {
+        improving = 0;
+        step *= 0.9f;
+      }
+      lastEnergy = energy;
+      if (step < k * Tolerance) break;
+      progress = (std::max)({ progress, float(iter + 1) / MaxIterations, std::log(startStep / step) / std::log(startStep / (k * Tolerance)) });
+      if (!report((std::min)(progress, 1.0f))) return false;
+    }
+    return true;
+  }
+
+  // Merges each node with its least connected free neighbour, so that chains halve in
+  // length. parent maps every node to its node in the returned, coarser graph.
+  Adjacency coarsen(const Adjacency &adjacent, std::vector<int> &parent) {
+    const int n = int(adjacent.size());
+    std::vector<int> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return adjacent[a].size() < adjacent[b].size(); });
+    parent.assign(n, -1);
+    int m = 0;
+    for (int v : order) {
+      if (parent[v] >= 0) continue;
+      int mate = -1;
+      for (int u : adjacent[v]) {
+        if (parent[u] < 0 && (mate < 0 || adjacent[u].size() < adjacent[mate].size())) mate = u;
+      }
+      parent[v] = m;
+      if (mate >= 0) parent[mate] = m;
+      m++;
+    }
+    Adjacency coarse(m);
+    for (int v = 0; v < n; v++) {
+      for (int u : adjacent[v]) {
+        if (parent[u] != parent[v]) coarse[parent[v]].push_back(parent[u]);
+      }
+    }
+    for (auto &adj : coarse) {
+      std::sort(adj.begin(), adj.end());
+      adj.erase(std::unique(adj.begin(), adj.end()), adj.end());
+    }
+    return coarse;
+  }
+
+} // anonymous namespace
+
+
+// Shared between a LayoutJob and its worker.
+struct ui::LayoutJob::Shared {
+  std::atomic<float> progress{ 0.0f };
+  std::atomic<bool> cancelled{ false };
+  std::atomic<bool> finished{ false };
+  std::mutex mutex;
+  std::vector<ImVec2> positions;  // newest published layout, guarded by mutex
+  uint64_t version = 0;           // guarded by mutex
+
+  void publish(const std::vector<ImVec2> &pos) {
+    std::lock_guard<std::mutex> lock(mutex);
+    positions = pos;
+    version++;
+  }
+};
+
+// What the worker lays out: states by index, their positions in canvas units and the
+// connections between them, without direction, duplicates or self-loops.
+struct ui::LayoutJob::Graph {
+  std::vector<ImVec2> pos;
+  Adjacency adjacent;
+  std::vector<char> movable;
+  std::vector<char> unplaced;  // movable states whose position means nothing yet
+  int root = 0;
+
+  bool hasFixed() const { return std::find(movable.begin(), movable.end(), 0) != movable.end(); }
+
+  // Moves a complete layout to the top-left of the canvas; with fixed states around,
+  // only keeps the others on the canvas.
+  void normalize(const std::vector<ImVec2> &in, std::vector<ImVec2> &out) const {
+    out = in;
+    if (hasFixed()) {
+      for (auto &p : out) p = ImVec2((std::max)(p.x, Margin), (std::max)(p.y, Margin));
+      return;
+    }
+    ImVec2 lo = out[0];
+    for (const auto &p : out) lo = ImVec2((std::min)(lo.x, p.x), (std::min)(lo.y, p.y));
+    for (auto &p : out) p = ImVec2(p.x - lo.x + Margin, p.y - lo.y + Margin);
+  }
+
+  void seedUnplaced(std::mt19937 &rng);
+  void layoutForce(Shared &shared);
+  void layoutLayered(Shared &shared);
+};
+
+// Starts each unplaced state next to a neighbour that has a position, spreading out from
+// the placed part; states with no placed state in reach are scattered around it.
+void ui::LayoutJob::Graph::seedUnplaced(std::mt19937 &rng)
+{
+  const int n = int(pos.size());
+  std::uniform_real_distribution<float> jitter(-NaturalLength * 0.5f, NaturalLength * 0.5f);
+  std::vector<int> queue;
+  ImVec2 centre;
+  for (int i = 0; i < n; i++) {
+    if (unplaced[i]) continue;
+    queue.push_back(i);
+    centre.x += pos[i].x;
+    centre.y += pos[i].y;
+  }
+  if (!queue.empty()) centre = ImVec2(centre.x / queue.size(), centre.y / queue.size());
+  std::vector<char> seeded(unplaced.size());
+  for (size_t head = 0; head < queue.size(); head++) {
+    const int v = queue[head];
+    for (int u : adjacent[v]) {
+      if (!unplaced[u] || seeded[u]) continue;
+      pos[u] = ImVec2(pos[v].x + jitter(rng), pos[v].y + jitter(rng));
+      seeded[u] = 1;
+      queue.push_back(u);
+    }
+  }
+  const float spread = NaturalLength * std::sqrt(float(n));
+  std::uniform_real_distribution<float> scatter(-spread * 0.5f, spread * 0.5f);
+  for (int i = 0; i < n; i++) {
+    if (unplaced[i] && !seeded[i]) pos[i] = ImVec2(centre.x + scatter(rng), centre.y + scatter(rng));
+  }
+}
+
+// Force-directed layout after Fruchterman and Reingold, with the adaptive step length and
+// multilevel scheme of Hu's "Efficient and high quality force-directed graph drawing":
+// every iteration moves each state a fixed step along its net force, the step growing
+// while the energy keeps falling and shrinking when it does not. A fresh layout is first
+// found for a coarsened copy of the graph and refined level by level, which untangles
+// long chains that a single level would leave folded. Repulsion falls off with the square
+// of the distance (Hu's p = 2) so the outer states of a large machine do not stretch its
+// edges.
+void ui::LayoutJob::Graph::layoutForce(Shared &shared)
+{
+  std::mt19937 rng(0x5eed);
+  std::vector<ImVec2> published;
+  auto lastPublish = std::chrono::steady_clock::now();
+  auto show = [&](const std::vector<ImVec2> &at) {
+    const auto now = std::chrono::steady_clock::now();
+    if (now - lastPublish < PublishInterval) return;
+    normalize(at, published);
+    shared.publish(published);
+    lastPublish = now;
+  };
+
+  if (hasFixed()) {
+    seedUnplaced(rng);
+    auto report = [&](float progress) {
+      shared.progress.store(progress, std::memory_order_relaxed);
+      show(pos);
+      return !shared.cancelled.load(std::memory_order_relaxed);
+    };
+    if (!relax(adjacent, pos, &movable, NaturalLength * RefineStep, report)) return;
+  } else {
+    std::vector<Adjacency> levels{ adjacent };
+    std::vector<std::vector<int>> parents;
+    size_t total = adjacent.size();
+    while (levels.back().size() > CoarsestSize) {
+      std::vector<int> parent;
+      Adjacency coarse = coarsen(levels.back(), parent);
+      if (coarse.size() > levels.back().size() * 3 / 4) break;
+      total += coarse.size();
+      parents.push_back(std::move(parent));
+      levels.push_back(std::move(coarse));
+    }
+
+    const float spread = NaturalLength * std::sqrt(float(levels.back().size()));
+    std::uniform_real_distribution<float> scatter(0.0f, spread);
+    std::vector<ImVec2> at(levels.back().size());
+    for (auto &p : at) p = ImVec2(scatter(rng), scatter(rng));
+    float done = 0;
+    for (size_t l = levels.size(); l-- > 0;) {
+      const float share = float(levels[l].size()) / total;
+      auto report = [&](float progress) {
+        shared.progress.store(done + share * progress, std::memory_order_relaxed);
+        if (l == 0) show(at);
+        return !shared.cancelled.load(std::memory_order_relaxed);
+      };
+      if (!relax(levels[l], at, nullptr, NaturalLength * (l + 1 == levels.size() ? 1.0f : RefineStep), report)) return;
+      done += share;
+      if (l == 0) break;
+      // Each node starts next to the one it was merged into, in a layout grown to fit them.
+      const float scale = std::sqrt(float(levels[l - 1].size()) / levels[l].size());
+      std::uniform_real_distribution<float> jitter(-NaturalLength * 0.25f, NaturalLength * 0.25f);
+      std::vector<ImVec2> finer(levels[l - 1].size());
+      for (size_t v = 0; v < finer.size(); v++) {
+        const ImVec2 p = at[parents[l - 1][v]];
+        finer[v] = ImVec2(p.x * scale + jitter(rng), p.y * scale + jitter(rng));
+      }
+      at.swap(finer);
+    }
+    pos.swap(at);
+  }
+  normalize(pos, published);
+  shared.publish(published);
+}
+
+// Layered layout after Sugiyama: states go into columns by their distance from the start
+// state, then each column is reordered by the barycentre of its neighbours in the column
+// before (and on the way back, after) it to cut down crossings.
+void ui::LayoutJob::Graph::layoutLayered(Shared &shared)
+{
+  const int n = int(pos.size());
+  std::vector<int> layer(n, -1);
+  std::vector<std::vector<int>> layers;
+  std::vector<int> queue;
+  queue.reserve(n);
+  auto visit = [&](int from) {
+    if (layer[from] >= 0) return;
+    layer[from] = 0;
+    queue.assign(1, from);
+    if (layers.empty()) layers.emplace_back();
+    for (size_t head = 0; head < queue.size(); head++) {
+      const int v = queue[head];
+      layers[layer[v]].push_back(v);
+      for (int u : adjacent[v]) {
+        if (layer[u] >= 0) continue;
+        layer[u] = layer[v] + 1;
+        if (int(layers.size()) <= layer[u]) layers.emplace_back();
+        queue.push_back(u);
+      }
+    }
+  };
+  // Further components start over in the first column.
+  visit(root);
+  for (int i = 0; i < n; i++) visit(i);
+
+  std::vector<float> order(n);
+  auto renumber = [&](std::vector<int> &column) {
+    for (size_t i = 0; i < column.size(); i++) order[column[i]] = float(i) - (float(column.size()) - 1) * 0.5f;
+  };
+  for (auto &column : layers) renumber(column);
+  std::vector<float> key(n);
+  for (int sweep = 0; sweep < OrderingSweeps; sweep++) {
+    if (shared.cancelled.load(std::memory_order_relaxed)) return;
+    const bool down = sweep % 2 == 0;
+    for (size_t li = 1; li < layers.size(); li++) {
+      auto &column = layers[down ? li : layers.size() - 1 - li];
+      for (int v : column) {
+        float sum = 0;
+        int count = 0;
+        for (int u : adjacent[v]) {
+          if (down ? layer[u] < layer[v] : layer[u] > layer[v]) {
+            sum += order[u];
+            count++;
+          }
+        }
+        key[v] = count ? sum / count : order[v];
+      }
+      std::stable_sort(column.begin(), column.end(), [&](int a, int b) { return key[a] < key[b]; });
+      renumber(column);
+    }
+    shared.progress.store(float(sweep + 1) / OrderingSweeps, std::memory_order_relaxed);
+  }
+
+  for (int v = 0; v < n; v++) {
+    pos[v] = ImVec2(layer[v] * LayerSpacing, order[v] * RowSpacing);
+  }
+  std::vector<ImVec2> published;
+  normalize(pos, published);
+  shared.publish(published);
+}
+
+
+//-----------------------------------------------------------------------------
+
+ui::LayoutJob::LayoutJob() = default;
+
+ui::LayoutJob::~LayoutJob()
+{
+  cancel();
+  if (worker_.joinable()) worker_.join();
+}
+
+bool ui::LayoutJob::start(const AppState &appState, Method method)
+{
+  return run(appState, method, nullptr);
+}
+
+bool ui::LayoutJob::placeNew(const AppState &appState, const std::vector<core::State> &states)
+{
+  if (states.empty()) return false;
+  return run(appState, Method::FORCE, &states);
+}
+
+bool ui::LayoutJob::run(const AppState &appState, Method method, const std::vector<core::State> *movable)
+{
+  if (isRunning()) return false;
+  const auto &tm = appState.tm();
+  if (tm.states().empty()) return false;
+
+  // Copy the graph with states numbered in machine order. A state without a position has
+  // no draw object to move, so it is left out.
+  auto graph = std::make_shared<Graph>();
+  states_.clear();
+  for (const auto &state : tm.states()) {
+    if (appState.hasStatePosition(state)) states_.push_back(state);
+  }
+  if (states_.empty()) return false;
+  const int n = int(states_.size());
+  std::map<core::State, int> index;
+  graph->pos.resize(n);
+  graph->adjacent.resize(n);
+  graph->movable.assign(n, movable ? 0 : 1);
+  graph->unplaced.assign(n, 0);
+  for (int i = 0; i < n; i++) {
+    index.emplace(states_[i], i);
+    graph->pos[i] = appState.screenToCanvas(appState.statePosition(states_[i]));
+    if (states_[i].isStart()) graph->root = i;
+  }
+  if (movable) {
+    for (const auto &state : *movable) {
+      if (auto it = index.find(state); it != index.end()) {
+        graph->movable[it->second] = 1;
+        graph->unplaced[it->second] = 1;
+      }
+    }
+  }
+  for (const auto &trans : tm.transitions()) {
+    auto from = index.find(trans.from()), to = index.find(trans.to());
+    if (from == index.end() || to == index.end() || from->second == to->second) continue;
+    graph->adjacent[from->second].push_back(to->second);
+    graph->adjacent[to->second].push_back(from->second);
+  }
+  for (auto &adj : graph->adjacent) {
+    std::sort(adj.begin(), adj.end());
+    adj.erase(std::unique(adj.begin(), adj.end()), adj.end());
+  }
+
+  generation_ = tm.generation();
+  applied_ = 0;
+  shared_ = std::make_shared<Shared>();
+  worker_ = std::thread([shared = shared_, graph, method]() {
+    if (method == Method::LAYERED) {
+      graph->layoutLayered(*shared);
+    } else {
+      graph->layoutForce(*shared);
+    }
+    shared->finished.store(true, std::memory_order_release);
+    });
+  return true;
+}
+
+void ui::LayoutJob::cancel()
+{
+  if (shared_) shared_->cancelled = true;
+}
+
+float ui::LayoutJob::progress() const
+{
+  return shared_ ? shared_->progress.load(std::memory_order_relaxed) : 0.0f;
+}
+
+std::optional<ui::LayoutJob::Outcome> ui::LayoutJob::poll(AppState &appState)
+{
+  if (!isRunning()) return std::nullopt;
+  if (appState.tm().generation() != generation_) cancel();
+  const bool finished = shared_->finished.load(std::memory_order_acquire);
+  if (shared_->cancelled) {
+    // Keep what is on the canvas: journal the positions applied so far, so recovery does
+    // not bring back the ones from before the layout.
+    if (!positions_.empty()) {
+      std::vector<core::State> placed;
+      std::vector<ImVec2> canvasPos;
+      for (const auto &state : states_) {
+        if (!appState.hasStatePosition(state)) continue;
+        placed.push_back(state);
+        canvasPos.push_back(appState.screenToCanvas(appState.statePosition(state)));
+      }
+      appState.placeStates(placed, canvasPos, true);
+      positions_.clear();
+    }
+  } else {
+    std::lock_guard<std::mutex> lock(shared_->mutex);
+    // Only the final layout goes into the journal.
+    if (shared_->version != applied_) {
+      positions_.swap(shared_->positions);
+      applied_ = shared_->version;
+      appState.placeStates(states_, positions_, finished);
+    } else if (finished && !positions_.empty()) {
+      appState.placeStates(states_, positions_, true);
+    }
+  }
+  if (!finished) return std::nullopt;
+  worker_.join();
+  auto shared = std::move(shared_);
+  states_.clear();
+  positions_.clear();
+  return shared->cancelled ? Outcome::CANCELLED : Outcome::SUCCEEDED;
+}
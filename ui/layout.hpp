@@ -0,0 +1,64 @@
+#ifndef _LAYOUT_HPP_
+#define _LAYOUT_HPP_
+
+#include "model/turingmachine.hpp"
+#include <imgui.h>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+class AppState;
+
+namespace ui {
+
+  // Automatic placement of states. The layout is computed on a worker thread from a copy
+  // of the graph; poll() moves the states to the newest positions the worker published,
+  // so the machine can be watched settling while the UI stays responsive.
+  class LayoutJob {
+  public:
+    enum class Method {
+      FORCE,    // force-directed, repulsion approximated with a Barnes-Hut quadtree
+      LAYERED,  // Sugiyama-style columns by distance from the start state
+    };
+    enum class Outcome { SUCCEEDED, CANCELLED };
+
+    LayoutJob();
+    ~LayoutJob();
+    LayoutJob(const LayoutJob &) = delete;
+    LayoutJob &operator=(const LayoutJob &) = delete;
+
+    // Both return false if a layout is already running or there is nothing to place, and
+    // copy what they need from appState before returning. start() lays out the whole
+    // machine; placeNew() arranges only `states` (e.g. ones loaded without a position)
+    // around the others, which stay where they are.
+    bool start(const AppState &appState, Method method);
+    bool placeNew(const AppState &appState, const std::vector<core::State> &states);
+    void cancel();
+
+    bool isRunning() const { return shared_ != nullptr; }
+    float progress() const;
+
+    // Applies positions published since the last call. Returns the outcome once, after
+    // the worker finished; nullopt while it is running or when idle. A layout of a
+    // machine that was edited in the meantime is abandoned as cancelled; positions already
+    // applied by a cancelled layout stay where they are and are journaled.
+    std::optional<Outcome> poll(AppState &appState);
+
+  private:
+    struct Shared;
+    struct Graph;
+    bool run(const AppState &appState, Method method, const std::vector<core::State> *movable);
+
+    std::vector<core::State> states_;
+    uint64_t generation_ = 0;
+    uint64_t applied_ = 0;
+    std::vector<ImVec2> positions_;
+    std::shared_ptr<Shared> shared_;
+    std::thread worker_;
+  };
+
+}
+
+#endif // _LAYOUT_HPP_
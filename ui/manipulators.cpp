@@ -120,7 +120,7 @@ void ui::TransitionManipulator::setNextPos(float x, float y, const ImVec2 &offse
         if (1) {
           auto fromPos{ appState.statePosition(transition.from()) };
           auto toPos{ appState.statePosition(transition.to()) };
-          const auto [distance, edgeFrom, edgeTo] = StatePosHelperData::calcEdges(fromPos, toPos);
+          const auto [distance, edgeFrom, edgeTo] = StatePosHelperData::calcEdges(fromPos, toPos, appState.zoom());
           if (distance < 0.001f) {
             handleSelfLoopManipulation(x, y, offset, drt->style_);
             //drt->setTransitionStyle(drt->style_);
@@ -152,7 +152,7 @@ void ui::TransitionManipulator::setLastPos(float x, float y)
     } else {
       drt->transition_.setTo(state);
     }
-    appState.tm().updateTransition(old, drt->transition_);
+    appState.updateTransition(old, drt->transition_);
   } else {
     auto tr{ *imp->origTransition_ };
     imp->origTransition_.reset();
@@ -234,8 +234,9 @@ void ui::TransitionManipulator::handleCurveManipulation(float x, float y, const
     perp.y /= len;
   }
 
-  // Method 1: Project mouse movement onto perpendicular direction
-  float projectedOffset = offset.x * perp.x + offset.y * perp.y;
+  // Method 1: Project mouse movement onto perpendicular direction (arc height is in canvas units)
+  const float zoom = appState.zoom();
+  float projectedOffset = (offset.x * perp.x + offset.y * perp.y) / zoom;
 
   // Account for current curve direction (alternating for multiple transitions)
   //float direction = (style.transitionIndex % 2 == 0) ? 1.0f : -1.0f;
@@ -247,7 +248,7 @@ void ui::TransitionManipulator::handleCurveManipulation(float x, float y, const
   // This gives more intuitive control and preserves sign for curve direction
   ImVec2 mousePos = ImVec2(x, y);
   ImVec2 mouseToMid = ImVec2(mousePos.x - mid.x, mousePos.y - mid.y);
-  float desiredHeight = mouseToMid.x * perp.x + mouseToMid.y * perp.y; // Keep sign!
+  float desiredHeight = (mouseToMid.x * perp.x + mouseToMid.y * perp.y) / zoom; // Keep sign!
 
   // Use a blend of both methods for smooth interaction
   float blendFactor = 0.7f; // Favor mouse position method
@@ -303,7 +304,7 @@ void ui::TransitionManipulator::handleSelfLoopManipulation(float x, float y, con
     int newIndex = (int)((angle * 180.0f / M_PI + 360.0f) / 60.0f) % 6;
     style.transitionIndex = newIndex;
   }
-  auto res = StatePosHelperData::calcEdgesSelfLink(pos, style);
+  auto res = StatePosHelperData::calcEdgesSelfLink(pos, style, dro_->appState()->zoom());
   handleCurveManipulation(x, y, offset, res.edgeTo, res.edgeFrom);
 }
 
@@ -362,17 +363,22 @@ void ui::SelectionManipulator::setNextPos(float x, float y, const ImVec2 &)
   drs->setPos1(x, y);
   auto rc = drs->boundingRect();
   auto &appState = *dro_->appState();
-  for (int j = 0; j < appState.nofDrawObjects(); j ++) {
-    auto obj = appState.getDrawObject(j);
-    if (!obj->asState()) continue;
-    if (io.KeyCtrl && obj->isSelected()) continue;
-    auto r = obj->boundingRect();
-    if (rc.intersects(r)) {
-      UNCONST(obj)->createManipulator();
-    } else {
-      UNCONST(obj)->removeManipulator();
+  std::vector<ui::DrawObject *> inside;
+  appState.queryObjects(rc, inside);
+  inside.erase(std::remove_if(inside.begin(), inside.end(), [](ui::DrawObject *obj) { return !obj->asState(); }), inside.end());
+  std::sort(inside.begin(), inside.end());
+  // Only states the band swept over can need deselecting, everything else was cleared when it started.
+  if (!io.KeyCtrl) {
+    for (auto *obj : banded_) {
+      if (!std::binary_search(inside.begin(), inside.end(), obj)) {
+        obj->removeManipulator();
+      }
     }
   }
+  for (auto *obj : inside) {
+    obj->createManipulator();
+  }
+  banded_.swap(inside);
 }
 
 void ui::SelectionManipulator::setLastPos(float x, float y)
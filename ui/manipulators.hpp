@@ -4,6 +4,7 @@
 #include "defs.hpp"
 #include <imgui.h>
 #include <memory>
+#include <vector>
 
 namespace ui {
 
@@ -75,6 +76,7 @@ namespace ui {
 
 
   class SelectionManipulator : public Manipulator {
+    std::vector<ui::DrawObject *> banded_;  // states currently inside the band, sorted
   public:
     SelectionManipulator(ui::DrawObject *p) : Manipulator(p) {}
     void draw(ImDrawList *dr) override;
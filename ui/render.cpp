@@ -15,8 +15,11 @@ We weave our stories, you and I.
 #include "app.hpp"
 #include "defs.hpp"
 #include "model/turingmachine.hpp"
+#include "model/tapeio.hpp"
 #include "ui/drawobject.hpp"
 #include "ui/serializer.hpp"
+#include "ui/journal.hpp"
+#include "ui/layout.hpp"
 #include "ui/imfilebrowser.h"
 #include <functional>
 #include <imgui.h>
@@ -26,7 +29,12 @@ We weave our stories, you and I.
 #include <cassert>
 #include <chrono>
 #include <algorithm>
+#include <cmath>
 #include <optional>
+#include <vector>
+#include <cctype>
+#include <climits>
+#include <cstdio>
 
 
 namespace {
@@ -37,10 +45,18 @@ namespace {
   float _canvasHeight = 0;
   std::string _statusMessage;
   std::optional<std::chrono::steady_clock::time_point> _statusTime;
+  bool _showSpaceTime = false;
+  int _breakStep = 1;
+  int _breakCell = 0;
+  int _watchFirst = 0;
+  int _watchLast = 0;
+  char _watchSymbol[20] = "";
+  ui::LayoutJob _layoutJob;
 #ifdef NO_FILEBROWSER
   std::array<char, 255> _fnameBuffer;
 #else
   std::optional<bool> _fileSaving;
+  FileJob _fileJob;
 #endif
 
   void styledButton(const char *label, bool active, bool enabled, std::function<void()> onClick) {
@@ -68,21 +84,24 @@ namespace {
   class TapeEditor {
     bool isEditing_ = false;
     int editingIndex_ = 0;
-    char editBuffer_[2] = "";
+    char editBuffer_[20] = "";
+    std::optional<int> focusedIndex_;  // cell that receives typed symbols
   public:
-    void startEdit(int tapeIndex, char currentValue) {
+    // currentValue is the symbol's name, "" for a blank.
+    void startEdit(int tapeIndex, const std::string &currentValue) {
       isEditing_ = true;
       editingIndex_ = tapeIndex;
-      editBuffer_[0] = (currentValue == '\0') ? '_' : currentValue;
-      editBuffer_[1] = '\0';
+      std::snprintf(editBuffer_, sizeof(editBuffer_), "%s", currentValue.empty() ? "_" : currentValue.c_str());
     }
     void cancelEdit() {
       isEditing_ = false;
     }
-    bool finishEdit(core::Tape &tape) {
+    bool finishEdit(AppState &appState) {
       if (isEditing_) {
-        char newValue = (editBuffer_[0] == '_') ? '\0' : editBuffer_[0];
-        tape.writeAt(editingIndex_, newValue);
+        const std::string name = std::strcmp(editBuffer_, "_") == 0 ? "" : editBuffer_;
+        if (auto code = appState.internSymbol(name)) {
+          appState.writeTapeCell(editingIndex_, *code);
+        }
         isEditing_ = false;
         return true;
       }
@@ -91,6 +110,70 @@ namespace {
     bool isEditing() const { return isEditing_; }
     int editingIndex() const { return editingIndex_; }
     char *editBuffer() { return editBuffer_; }
+    size_t editBufferSize() const { return sizeof(editBuffer_); }
+    void focus(int tapeIndex) { focusedIndex_ = tapeIndex; }
+    std::optional<int> focusedIndex() const { return focusedIndex_; }
+  };
+
+
+  // Symbol density across the whole used range of the tape (stretched to include the
+  // head), bucketed to the width of the minimap bar. Recomputed only when the tape or
+  // the range changes; pages that are empty or full are accounted for without reading
+  // their cells, so this stays cheap on tapes of millions of cells.
+  class TapeMinimap {
+    uint64_t version_ = 0;
+    std::pair<int, int> range_{ 0, -1 };
+    int maxBuckets_ = 0;
+    std::vector<float> density_;
+  public:
+    std::pair<int, int> range() const { return range_; }
+    const std::vector<float> &density(const core::Tape &tape, int maxBuckets) {
+      auto range = tape.getUsedRange();
+      range.first = (std::min)(range.first, tape.head());
+      range.second = (std::max)(range.second, tape.head());
+      if (tape.version() == version_ && range == range_ && maxBuckets == maxBuckets_) {
+        return density_;
+      }
+      version_ = tape.version();
+      range_ = range;
+      maxBuckets_ = maxBuckets;
+
+      const double span = double(range.second) - range.first + 1;
+      const int buckets = static_cast<int>((std::min)(span, double((std::max)(1, maxBuckets))));
+      const double width = span / buckets;
+      std::vector<double> counts(buckets, 0.0);
+      auto bucketOf = [&](double index) {
+        return std::clamp(static_cast<int>((index - range.first) / width), 0, buckets - 1);
+      };
+      // Adds the run of non-blank cells [a, b) to the buckets it overlaps.
+      auto addRun = [&](double a, double b) {
+        for (int k = bucketOf(a), last = bucketOf(b - 1); k <= last; k++) {
+          const double lo = (std::max)(a, range.first + k * width);
+          const double hi = (std::min)(b, range.first + (k + 1) * width);
+          counts[k] += (std::max)(0.0, hi - lo);
+        }
+      };
+      std::vector<char> cells;
+      tape.forEachPage([&](int first, int filled) {
+        if (filled == 0) return;
+        if (filled == core::Tape::PageSize) {
+          addRun(first, double(first) + core::Tape::PageSize);
+        } else if (width >= core::Tape::PageSize) {
+          counts[bucketOf(first + core::Tape::PageSize / 2)] += filled;
+        } else {
+          cells.resize(core::Tape::PageSize);
+          tape.readRange(first, cells.data(), cells.size());
+          for (int i = 0; i < core::Tape::PageSize; i++) {
+            if (cells[i] != core::Tape::Blank) counts[bucketOf(double(first) + i)] += 1.0;
+          }
+        }
+        });
+      density_.resize(buckets);
+      for (int k = 0; k < buckets; k++) {
+        density_[k] = static_cast<float>((std::min)(1.0, counts[k] / width));
+      }
+      return density_;
+    }
   };
 
 } // anonymous namespace
@@ -99,6 +182,7 @@ void drawToolbar(AppState &);
 void drawCanvas(AppState &);
 void drawTape(AppState &);
 void drawStatusBar(AppState &);
+void drawSpaceTime(AppState &);
 void handleToolbar(AppState &);
 void drawTempTransition(AppState &);
 void canvasLeftMouseButtonClicked(AppState &, ImGuiIO &);
@@ -107,10 +191,21 @@ void drawInfoPanel(AppState &, const ImVec2 &topLeft);
 
 void ui::render(AppState &appState)
 {
+  // Machines loaded without positions are laid out as soon as they arrive; a layout of
+  // the previous machine notices the change and stops first.
+  if (!_layoutJob.isRunning()) {
+    _layoutJob.placeNew(appState, appState.takeUnplacedStates());
+  }
   drawToolbar(appState);
   drawStatusBar(appState);
   drawTape(appState);
   drawCanvas(appState);
+  drawSpaceTime(appState);
+
+  // Keep the text cursor blinking while a field is being edited.
+  if (ImGui::GetIO().WantTextInput) {
+    appState.frameScheduler().requestFrameIn(std::chrono::milliseconds(250));
+  }
 }
 
 void drawToolbar(AppState &appState)
@@ -118,6 +213,10 @@ void drawToolbar(AppState &appState)
   ImGui::Begin("Toolbar", nullptr, ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoMove);
   ImGui::SetWindowPos(ImVec2(0, 0), ImGuiCond_Always);
 
+#if !NO_FILEBROWSER
+  ImGui::BeginDisabled(_fileJob.isRunning());
+#endif
+
   // Load button  
   if (ImGui::Button(ICON_FA_FOLDER_OPEN "", { 24.f, 0.f })) {
 #if NO_FILEBROWSER
@@ -152,6 +251,22 @@ void drawToolbar(AppState &appState)
 #endif
   }
 
+#if !NO_FILEBROWSER
+  ImGui::SameLine();
+  if (ImGui::Button(ICON_FA_FILE_IMPORT "", { 24.f, 0.f })) {
+    AppSerializer::importTapeWithDialog(appState);
+  }
+  if (ImGui::IsItemHovered()) ImGui::SetTooltip("Import raw tape file at head");
+
+  ImGui::SameLine();
+  if (ImGui::Button(ICON_FA_FILE_EXPORT "", { 24.f, 0.f })) {
+    AppSerializer::exportTapeWithDialog(appState);
+  }
+  if (ImGui::IsItemHovered()) ImGui::SetTooltip("Export used tape range to raw file");
+
+  ImGui::EndDisabled();
+#endif
+
 #if NO_FILEBROWSER
   ImGui::SameLine();
   if (ImGui::InputText("##edit", _fnameBuffer.data(), _fnameBuffer.size(),
@@ -202,11 +317,7 @@ void drawToolbar(AppState &appState)
     if (_fileSaving.value()) {
       if (AppState::fileBrowserSave().HasSelected()) {
         auto path = AppState::fileBrowserSave().GetSelected();
-        if (AppSerializer::saveToFile(appState, std::string{ path.string() })) {
-          _statusMessage = "Saved successfully!";
-          _statusTime = std::chrono::steady_clock::now();
-          appState.setWindowTitle(path.filename().string());
-        } else {
+        if (!_fileJob.startSave(appState, path.string())) {
           _statusMessage = "Save failed!";
           _statusTime = std::chrono::steady_clock::now();
         }
@@ -216,11 +327,7 @@ void drawToolbar(AppState &appState)
     } else {
       if (AppState::fileBrowserOpen().HasSelected()) {
         auto path = AppState::fileBrowserOpen().GetSelected();
-
-        if (AppSerializer::loadFromFile(appState, std::string{ path.string() })) {
-          _statusMessage = "Loaded successfully!";
-          _statusTime = std::chrono::steady_clock::now();
-        } else {
+        if (!_fileJob.startLoad(path.string())) {
           _statusMessage = "Load failed!";
           _statusTime = std::chrono::steady_clock::now();
         }
@@ -229,6 +336,29 @@ void drawToolbar(AppState &appState)
       }
     }
   }
+  AppState::fileBrowserTapeImport().Display();
+  AppState::fileBrowserTapeExport().Display();
+  for (const bool exporting : { false, true }) {
+    auto &dlg = exporting ? AppState::fileBrowserTapeExport() : AppState::fileBrowserTapeImport();
+    if (!dlg.HasSelected()) continue;
+    auto &tape = appState.tm().tape();
+    auto path = dlg.GetSelected();
+    size_t cells = 0;
+    bool ok = exporting
+      ? core::exportRawTape(tape, path.string(), &cells)
+      : core::importRawTape(tape, path.string(), tape.head(), &cells);
+    if (ok) {
+      _statusMessage = std::format("{} {} cells", exporting ? "Exported" : "Imported", cells);
+      // Bulk imports are folded into a snapshot instead of being journaled cell by cell.
+      if (!exporting && appState.journal()) {
+        appState.journal()->compact(appState);
+      }
+    } else {
+      _statusMessage = exporting ? "Tape export failed!" : "Tape import failed!";
+    }
+    _statusTime = std::chrono::steady_clock::now();
+    dlg.ClearSelected();
+  }
 #endif
 
   ImGui::SameLine();
@@ -265,6 +395,14 @@ void drawToolbar(AppState &appState)
     _statusTime = std::nullopt;
     });
   ImGui::SameLine();
+  styledButton(ICON_FA_FAST_FORWARD "", false, menu != M::RUNNING, [&] {
+    appState.setMenu(M::RUNNING);
+    appState.runToBreakpoint();
+    _statusMessage = "Running to breakpoint";
+    _statusTime = std::nullopt;
+    });
+  if (ImGui::IsItemHovered()) ImGui::SetTooltip("Run at full speed to the next breakpoint");
+  ImGui::SameLine();
   styledButton(ICON_FA_STEP_FORWARD "", false, menu != M::RUNNING, [&] {
     appState.setMenu(M::PAUSED);
     appState.stepExecution();
@@ -286,6 +424,134 @@ void drawToolbar(AppState &appState)
     _statusTime = std::chrono::steady_clock::now();
     });
 
+  // The executor pauses by itself at a breakpoint and stops at a budget.
+  const auto execState = appState.getExecutionState();
+  if (menu == M::RUNNING && execState == core::ExecutionState::BUDGET_EXCEEDED) {
+    appState.setMenu(M::PAUSED);
+    _statusMessage = std::format("Stopped at step {}: {} budget exceeded", appState.getStepCount(),
+      core::budgetLimitToStr(appState.exceededLimit()));
+    _statusTime = std::nullopt;
+  } else if (menu == M::RUNNING && execState == core::ExecutionState::CANCELLED) {
+    appState.setMenu(M::PAUSED);
+    _statusMessage = std::format("Cancelled at step {}", appState.getStepCount());
+    _statusTime = std::nullopt;
+  } else if (menu == M::RUNNING && execState == core::ExecutionState::PAUSED) {
+    appState.setMenu(M::PAUSED);
+    using B = core::Breakpoints;
+    const uint8_t hit = appState.breakpointHit();
+    std::string what;
+    for (auto [kind, name] : { std::pair{ B::STATE, "state" }, { B::TRANSITION, "transition" }, { B::STEP, "step" }, { B::CELL, "cell" }, { B::WATCH, "watch" } }) {
+      if (hit & kind) what += (what.empty() ? "" : ", ") + std::string(name);
+    }
+    _statusMessage = std::format("Breakpoint ({}) hit at step {}", what, appState.getStepCount());
+    if (const auto &w = appState.watchHit(); w && (hit & B::WATCH)) {
+      _statusMessage += std::format(", cell {} changed to '{}'", w->cell, appState.tm().symbols().name(w->symbol));
+    }
+    _statusTime = std::nullopt;
+  }
+
+  auto &bps = appState.breakpoints();
+  ImGui::SameLine();
+  styledButton(ICON_FA_BUG "", !bps.empty(), true, [&] { ImGui::OpenPopup("Breakpoints"); });
+  if (ImGui::IsItemHovered()) ImGui::SetTooltip("Breakpoints");
+  if (ImGui::BeginPopup("Breakpoints")) {
+    if (ImGui::Selectable("Toggle on selected states and transitions", false, ImGuiSelectableFlags_DontClosePopups)) {
+      appState.toggleSelectedBreakpoints();
+    }
+    ImGui::SetNextItemWidth(96);
+    ImGui::InputInt("##breakStep", &_breakStep);
+    ImGui::SameLine();
+    if (ImGui::SmallButton("Break after step")) bps.setStep(static_cast<size_t>((std::max)(1, _breakStep)), true);
+    ImGui::SetNextItemWidth(96);
+    ImGui::InputInt("##breakCell", &_breakCell);
+    ImGui::SameLine();
+    if (ImGui::SmallButton("Break on cell")) bps.setCell(_breakCell, true);
+    ImGui::SetNextItemWidth(96);
+    ImGui::InputInt("##watchFirst", &_watchFirst);
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(96);
+    ImGui::InputInt("##watchLast", &_watchLast);
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(48);
+    ImGui::InputText("##watchSymbol", _watchSymbol, sizeof(_watchSymbol));
+    if (ImGui::IsItemHovered()) ImGui::SetTooltip("Only changes to this symbol; empty for any");
+    ImGui::SameLine();
+    if (ImGui::SmallButton("Watch cells")) {
+      core::Tape::Watchpoint w{ (std::min)(_watchFirst, _watchLast), (std::max)(_watchFirst, _watchLast), std::nullopt };
+      if (_watchSymbol[0]) w.symbol = appState.tm().symbols().find(_watchSymbol);
+      if (!_watchSymbol[0] || w.symbol) {
+        bps.addWatch(w);
+      } else {
+        _statusMessage = std::format("Unknown symbol '{}'", _watchSymbol);
+        _statusTime = std::chrono::steady_clock::now();
+      }
+    }
+    if (!bps.empty()) {
+      ImGui::Separator();
+      // Removal waits until the lists are no longer being walked.
+      std::function<void()> remove;
+      int row = 0;
+      auto entry = [&](const std::string &text, std::function<void()> onRemove) {
+        ImGui::PushID(row++);
+        if (ImGui::SmallButton("x")) remove = std::move(onRemove);
+        ImGui::SameLine();
+        ImGui::TextUnformatted(text.c_str());
+        ImGui::PopID();
+        };
+      for (const auto &name : bps.states()) {
+        entry("Enter " + name, [&, name] { bps.setState(name, false); });
+      }
+      const auto &tm = appState.tm();
+      for (const auto &t : tm.transitions()) {
+        if (!bps.hasTransition(t.id())) continue;
+        entry(std::format("Take {} -> {} ({} / {})", t.from().name(), t.to().name(),
+          tm.symbols().name(t.readSymbol()), tm.symbols().name(t.writeSymbol())),
+          [&, id = t.id()] { bps.setTransition(id, false); });
+      }
+      for (size_t step : bps.steps()) {
+        entry(std::format("After step {}", step), [&, step] { bps.setStep(step, false); });
+      }
+      for (int cell : bps.cells()) {
+        entry(std::format("Head on cell {}", cell), [&, cell] { bps.setCell(cell, false); });
+      }
+      for (size_t i = 0; i < bps.watches().size(); i++) {
+        const auto &w = bps.watches()[i];
+        std::string text = w.first == w.last ? std::format("Cell {} changes", w.first) : std::format("Cells {} to {} change", w.first, w.last);
+        if (w.symbol) text += std::format(" to '{}'", appState.tm().symbols().name(*w.symbol));
+        entry(text, [&, i] { bps.removeWatch(i); });
+      }
+      if (remove) remove();
+      if (ImGui::SmallButton("Clear all")) bps.clear();
+    }
+    ImGui::EndPopup();
+  }
+
+  ImGui::SameLine();
+  styledButton(ICON_FA_COG "", false, true, [&] { ImGui::OpenPopup("Budget"); });
+  if (ImGui::IsItemHovered()) ImGui::SetTooltip("Limits of a run");
+  if (ImGui::BeginPopup("Budget")) {
+    auto budget = appState.executionBudget();
+    int steps = static_cast<int>((std::min)(budget.steps, size_t(INT_MAX)));
+    int seconds = static_cast<int>(std::chrono::duration_cast<std::chrono::seconds>(budget.wallTime).count());
+    int cells = static_cast<int>((std::min)(budget.tapeCells, size_t(INT_MAX)));
+    int megabytes = static_cast<int>(budget.memoryBytes >> 20);
+    ImGui::TextUnformatted("0 means no limit");
+    ImGui::PushItemWidth(120);
+    bool changed = ImGui::InputInt("Steps", &steps, 1000, 100000);
+    changed |= ImGui::InputInt("Time (s)", &seconds, 1, 60);
+    changed |= ImGui::InputInt("Tape cells", &cells, 1000, 100000);
+    changed |= ImGui::InputInt("Memory (MB)", &megabytes, 1, 64);
+    ImGui::PopItemWidth();
+    if (changed) {
+      budget.steps = static_cast<size_t>((std::max)(0, steps));
+      budget.wallTime = std::chrono::seconds((std::max)(0, seconds));
+      budget.tapeCells = static_cast<size_t>((std::max)(0, cells));
+      budget.memoryBytes = static_cast<size_t>((std::max)(0, megabytes)) << 20;
+      appState.setExecutionBudget(budget);
+    }
+    ImGui::EndPopup();
+  }
+
   float speed = appState.executionSpeed();
   ImGui::SameLine();
   ImGui::PushItemWidth(96);
@@ -294,6 +560,22 @@ void drawToolbar(AppState &appState)
   }
   ImGui::PopItemWidth();
 
+  ImGui::SameLine();
+  styledButton(ICON_FA_PROJECT_DIAGRAM "", _layoutJob.isRunning(), !_layoutJob.isRunning() && !appState.tm().states().empty(),
+    [&] { ImGui::OpenPopup("AutoLayout"); });
+  if (ImGui::IsItemHovered()) ImGui::SetTooltip("Arrange states automatically");
+  if (ImGui::BeginPopup("AutoLayout")) {
+    std::optional<ui::LayoutJob::Method> method;
+    if (ImGui::Selectable("Force-directed")) method = ui::LayoutJob::Method::FORCE;
+    if (ImGui::Selectable("Layered from start state")) method = ui::LayoutJob::Method::LAYERED;
+    if (method) _layoutJob.start(appState, *method);
+    ImGui::EndPopup();
+  }
+
+  ImGui::SameLine();
+  styledButton(ICON_FA_STREAM "", _showSpaceTime, true, [&] { _showSpaceTime = !_showSpaceTime; });
+  if (ImGui::IsItemHovered()) ImGui::SetTooltip("Space-time diagram of the run");
+
   _toolbarHeight = ImGui::GetWindowHeight();
   ImGui::End();
 }
@@ -301,10 +583,12 @@ void drawToolbar(AppState &appState)
 void drawTape(AppState &appState)
 {
   static TapeEditor editor;
+  static TapeMinimap minimap;
 
   ImGuiIO &io = ImGui::GetIO();
-  const float h = 60.0f;
+  const float h = 76.0f;
   const float cellSize = 40.0f;
+  const float minimapHeight = 10.0f;
 
   ImGui::Begin("Tape", nullptr, ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoMove);
   ImGui::SetWindowPos(ImVec2(0, io.DisplaySize.y - h - _statusBarHeight + 2), ImGuiCond_Always);
@@ -316,31 +600,43 @@ void drawTape(AppState &appState)
 
   const int numCells = static_cast<int>(std::ceil(io.DisplaySize.x / cellSize));
   const ImVec2 startPos = ImGui::GetWindowPos() + ImVec2{ 0, 1 };
+  const int firstIndex = tape.head() - numCells / 2;
 
   if (editor.isEditing()) {
     if (ImGui::IsKeyPressed(ImGuiKey_Enter)) {
-      editor.finishEdit(tape);
+      editor.finishEdit(appState);
     } else if (ImGui::IsKeyPressed(ImGuiKey_Escape)) {
       editor.cancelEdit();
     }
   }
 
+  // The visible cells are drawn straight into the draw list from one bulk read; only the
+  // cell being edited gets a widget.
+  std::string cells(static_cast<size_t>(numCells), core::Tape::Blank);
+  tape.readRange(firstIndex, cells.data(), cells.size());
+  const auto focused = editor.focusedIndex();
+  char indexText[16];
   for (int i = 0; i < numCells; ++i) {
     const bool middleCell = i == numCells / 2;
-    const int tapeIndex = tape.head() + i - numCells / 2;
+    const int tapeIndex = firstIndex + i;
     const ImVec2 cellPos = ImVec2(startPos.x + i * cellSize, startPos.y);
+    const ImVec2 cellEnd = ImVec2(cellPos.x + cellSize, cellPos.y + cellSize);
+    const bool editing = editor.isEditing() && editor.editingIndex() == tapeIndex;
 
     ImU32 cellColor = middleCell ? Colors::blue : Colors::pastelBlue;
-    if (editor.isEditing() && editor.editingIndex() == tapeIndex) {
+    if (editing) {
       cellColor = Colors::yellow;
     }
 
-    const char c = tape.readAt(tapeIndex);
+    const char c = cells[i];
     if (c != core::Tape::Blank)
-      dr->AddRectFilled(cellPos, ImVec2(cellPos.x + cellSize, cellPos.y + cellSize), utils::colorFromChar(c));
+      dr->AddRectFilled(cellPos, cellEnd, utils::colorFromChar(c));
 
-    dr->AddRectFilled(cellPos, ImVec2(cellPos.x + cellSize, cellPos.y + cellSize), IM_COL32(255, 255, 255, 50));
-    dr->AddRect(cellPos, ImVec2(cellPos.x + cellSize, cellPos.y + cellSize), cellColor, 0.0f, 0, 2.0f);
+    dr->AddRectFilled(cellPos, cellEnd, IM_COL32(255, 255, 255, 50));
+    dr->AddRect(cellPos, cellEnd, cellColor, 0.0f, 0, 2.0f);
+    if (!editing && focused == tapeIndex) {
+      dr->AddRect(ImVec2(cellPos.x + 3, cellPos.y + 3), ImVec2(cellEnd.x - 3, cellEnd.y - 3), Colors::gray, 0.0f, 0, 1.0f);
+    }
 
     if (middleCell) {
       dr->AddTriangleFilled(
@@ -350,80 +646,110 @@ void drawTape(AppState &appState)
         Colors::red);
     }
 
-    if (editor.isEditing() && editor.editingIndex() == tapeIndex) {
+    if (editing) {
       ImGui::SetCursorScreenPos(ImVec2(cellPos.x + cellSize * 0.3f, cellPos.y + cellSize * 0.3f));
       ImGui::PushItemWidth(cellSize * 0.4f);
       ImGui::SetKeyboardFocusHere();
 
-      if (ImGui::InputText("##edit", editor.editBuffer(), sizeof(editor.editBuffer()),
+      if (ImGui::InputText("##edit", editor.editBuffer(), editor.editBufferSize(),
         ImGuiInputTextFlags_CharsNoBlank | ImGuiInputTextFlags_AutoSelectAll | ImGuiInputTextFlags_EnterReturnsTrue)) {
-        editor.finishEdit(tape);
+        editor.finishEdit(appState);
       }
 
       if (!ImGui::IsItemActive() && ImGui::IsMouseClicked(ImGuiMouseButton_Left)) {
         ImVec2 mousePos = ImGui::GetMousePos();
-        if (mousePos.x < cellPos.x || mousePos.x > cellPos.x + cellSize ||
-          mousePos.y < cellPos.y || mousePos.y > cellPos.y + cellSize) {
+        if (mousePos.x < cellPos.x || mousePos.x > cellEnd.x ||
+          mousePos.y < cellPos.y || mousePos.y > cellEnd.y) {
           editor.cancelEdit();
         }
       }
 
       ImGui::PopItemWidth();
     } else {
-      std::string cellText = (c == core::Tape::Blank) ? "_" : std::string(1, c);
-      ImVec2 textSize = ImGui::CalcTextSize(cellText.c_str());
-      ImVec2 textPos = ImVec2(cellPos.x + (cellSize - textSize.x) * 0.5f, cellPos.y + (cellSize - textSize.y) * 0.5f);
-
-      ImGui::SetCursorScreenPos(textPos);
-      ImGui::PushID(tapeIndex);
+      const char *cellText = c == core::Tape::Blank ? "_" : tm.symbols().name(c).c_str();
+      ImVec2 textSize = ImGui::CalcTextSize(cellText);
+      dr->AddText(ImVec2(cellPos.x + (cellSize - textSize.x) * 0.5f, cellPos.y + (cellSize - textSize.y) * 0.5f),
+        ImGui::GetColorU32(ImGuiCol_Text), cellText);
+    }
 
-      if (ImGui::Selectable("##cell", false, ImGuiSelectableFlags_AllowDoubleClick, ImVec2(textSize.x, textSize.y))) {
-        if (ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left)) {
-          editor.startEdit(tapeIndex, c);
-        }
-      }
-      if (ImGui::IsItemFocused()) { 
-        if (ImGui::IsKeyPressed(ImGuiKey_F2)) {
-          editor.startEdit(tapeIndex, c);
-        } else {
-          ImGuiIO &io = ImGui::GetIO();
-          for (int k = 0; k < IM_ARRAYSIZE(io.KeysDown); k++) {
-            if (io.KeysDown[k]) {
-              //char keyPressed = static_cast<char>(k); // ImGuiKey index
-              if (k < 128 && 0 < k && std::isalnum(k))
-                editor.startEdit(tapeIndex, static_cast<char>(k));
-            }
-          }
+    std::snprintf(indexText, sizeof(indexText), "%d", tapeIndex);
+    dr->AddText(ImVec2(cellPos.x + 4, cellPos.y), Colors::lightGray, indexText);
+  }
 
+  // One invisible item covers the strip and handles mouse and keyboard for every cell.
+  ImGui::SetCursorScreenPos(startPos);
+  ImGui::InvisibleButton("##cells", ImVec2(numCells * cellSize, cellSize));
+  if (ImGui::IsItemHovered()) {
+    const int i = std::clamp(static_cast<int>((io.MousePos.x - startPos.x) / cellSize), 0, numCells - 1);
+    const int tapeIndex = firstIndex + i;
+    const char c = cells[i];
+    if (ImGui::IsMouseClicked(ImGuiMouseButton_Left)) {
+      editor.focus(tapeIndex);
+    }
+    if (ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left)) {
+      editor.startEdit(tapeIndex, tm.symbols().name(c));
+    } else if (!editor.isEditing()) {
+      ImGui::BeginTooltip();
+      ImGui::Text("Cell %d: '%s'", tapeIndex, c == core::Tape::Blank ? "_" : tm.symbols().name(c).c_str());
+      ImGui::Text("Double-click to edit");
+      ImGui::EndTooltip();
+    }
+  }
+  if (focused && !editor.isEditing() && ImGui::IsWindowFocused()) {
+    if (ImGui::IsKeyPressed(ImGuiKey_F2)) {
+      editor.startEdit(*focused, tm.symbols().name(tape.readAt(*focused)));
+    } else if (ImGui::IsKeyPressed(ImGuiKey_LeftArrow)) {
+      editor.focus(*focused - 1);
+    } else if (ImGui::IsKeyPressed(ImGuiKey_RightArrow)) {
+      editor.focus(*focused + 1);
+    } else {
+      for (int n = 0; n < io.InputQueueCharacters.Size; n++) {
+        const ImWchar ch = io.InputQueueCharacters[n];
+        if (ch < 128 && std::isalnum(ch)) {
+          editor.startEdit(*focused, std::string(1, static_cast<char>(ch)));
+          break;
         }
       }
-
-      ImGui::SetCursorScreenPos(textPos);
-      ImGui::TextUnformatted(cellText.c_str());
-
-      if (ImGui::IsItemHovered()) {
-        ImGui::BeginTooltip();
-        ImGui::Text("Cell %d: '%s'", tapeIndex, cellText.c_str());
-        ImGui::Text("Double-click to edit");
-        ImGui::EndTooltip();
-      }
-
-      ImGui::PopID();
     }
+  }
 
-    ImGui::SetCursorScreenPos(ImVec2(cellPos.x + 4, cellPos.y));
-    ImGui::PushStyleColor(ImGuiCol_Text, Colors::lightGray);
-    ImGui::Text("%d", tapeIndex);
-    ImGui::PopStyleColor();
+  // Minimap: density over the used range, the visible window and the head; click or drag to
+  // move the head there.
+  const ImVec2 mapPos = ImVec2(startPos.x + 4, startPos.y + cellSize + 3);
+  const float mapWidth = io.DisplaySize.x - 8;
+  const auto &density = minimap.density(tape, static_cast<int>(mapWidth / 2));
+  const auto [mapFirst, mapLast] = minimap.range();
+  const double mapSpan = double(mapLast) - mapFirst + 1;
+  auto mapX = [&](double index) { return mapPos.x + static_cast<float>((index - mapFirst) / mapSpan * mapWidth); };
+  dr->AddRectFilled(mapPos, ImVec2(mapPos.x + mapWidth, mapPos.y + minimapHeight), Colors::pastelGray);
+  const float bucketWidth = mapWidth / density.size();
+  for (size_t k = 0; k < density.size(); k++) {
+    if (density[k] <= 0.0f) continue;
+    const float x = mapPos.x + k * bucketWidth;
+    dr->AddRectFilled(ImVec2(x, mapPos.y + minimapHeight * (1.0f - density[k])), ImVec2(x + bucketWidth, mapPos.y + minimapHeight), Colors::royalBlue);
+  }
+  dr->AddRect(ImVec2(mapX(firstIndex), mapPos.y), ImVec2((std::max)(mapX(double(firstIndex) + numCells), mapX(firstIndex) + 2), mapPos.y + minimapHeight), Colors::black);
+  dr->AddLine(ImVec2(mapX(tape.head() + 0.5), mapPos.y), ImVec2(mapX(tape.head() + 0.5), mapPos.y + minimapHeight), Colors::red, 2.0f);
+  ImGui::SetCursorScreenPos(mapPos);
+  ImGui::InvisibleButton("##minimap", ImVec2(mapWidth, minimapHeight));
+  if (ImGui::IsItemActive()) {
+    const double t = std::clamp((io.MousePos.x - mapPos.x) / mapWidth, 0.0f, 1.0f);
+    tape.setHead(static_cast<int>(std::floor((std::min)(mapFirst + t * mapSpan, double(mapLast)))));
+  } else if (ImGui::IsItemHovered()) {
+    const double t = std::clamp((io.MousePos.x - mapPos.x) / mapWidth, 0.0f, 1.0f);
+    ImGui::SetTooltip("Cells %d to %d, %zu non-blank\nClick to move the head to cell %d", mapFirst, mapLast,
+      tape.getNonBlankCellCount(), static_cast<int>(std::floor((std::min)(mapFirst + t * mapSpan, double(mapLast)))));
   }
 
-  ImGui::SetCursorScreenPos(ImVec2(startPos.x + 5, startPos.y + cellSize + 1));
+  ImGui::SetCursorScreenPos(ImVec2(startPos.x + 5, mapPos.y + minimapHeight + 3));
   if (ImGui::SmallButton("<<")) { tape.moveLeft(); tape.moveLeft(); tape.moveLeft(); }
   ImGui::SameLine();
   if (ImGui::SmallButton("<")) { tape.moveLeft(); }
   ImGui::SameLine();
 
-  auto fmtAlphabet = std::format("\tAlphabet: [{}]", utils::join(tape.alphabet()));
+  std::vector<std::string> alphabet;
+  for (char c : tape.alphabet()) alphabet.push_back(tm.symbols().name(c));
+  auto fmtAlphabet = std::format("\tAlphabet: [{}]", utils::join(alphabet));
   ImGui::TextUnformatted(fmtAlphabet.c_str());
 
   ImGui::SameLine();
@@ -437,7 +763,7 @@ void drawTape(AppState &appState)
   if (ImGui::SmallButton(ICON_FA_TIMES " Clear")) {
     for (int i = 0; i < numCells; ++i) {
       int idx = tape.head() + i - numCells / 2;
-      tape.writeAt(idx, core::Tape::Blank);
+      appState.writeTapeCell(idx, core::Tape::Blank);
     }
   }
 
@@ -453,11 +779,51 @@ void drawStatusBar(AppState &appState)
   ImGui::SetWindowPos(ImVec2(0, io.DisplaySize.y - h), ImGuiCond_Always);
   ImGui::SetWindowSize(ImVec2(io.DisplaySize.x, h), ImGuiCond_Always);
 
-  if (!_statusMessage.empty()) {
+#if !NO_FILEBROWSER
+  const bool loading = _fileJob.kind() == FileJob::Kind::LOAD;
+  if (auto outcome = _fileJob.poll(appState)) {
+    switch (*outcome) {
+    case FileJob::Outcome::SUCCEEDED: _statusMessage = loading ? "Loaded successfully!" : "Saved successfully!"; break;
+    case FileJob::Outcome::FAILED: _statusMessage = loading ? "Load failed!" : "Save failed!"; break;
+    case FileJob::Outcome::CANCELLED: _statusMessage = loading ? "Load cancelled" : "Save cancelled"; break;
+    }
+    _statusTime = std::chrono::steady_clock::now();
+  }
+#endif
+  if (auto outcome = _layoutJob.poll(appState)) {
+    _statusMessage = *outcome == ui::LayoutJob::Outcome::SUCCEEDED ? "Layout done" : "Layout cancelled";
+    _statusTime = std::chrono::steady_clock::now();
+  }
+#if !NO_FILEBROWSER
+  if (_fileJob.isRunning()) {
+    ImGui::TextUnformatted(loading ? "Loading..." : "Saving...");
+    ImGui::SameLine();
+    ImGui::ProgressBar(_fileJob.progress(), ImVec2(200, 0));
+    ImGui::SameLine();
+    if (ImGui::SmallButton("Cancel")) {
+      _fileJob.cancel();
+    }
+    appState.frameScheduler().requestFrameIn(std::chrono::milliseconds(100));
+  } else
+#endif
+  if (_layoutJob.isRunning()) {
+    ImGui::TextUnformatted("Arranging states...");
+    ImGui::SameLine();
+    ImGui::ProgressBar(_layoutJob.progress(), ImVec2(200, 0));
+    ImGui::SameLine();
+    if (ImGui::SmallButton("Cancel##layout")) {
+      _layoutJob.cancel();
+    }
+    // Positions arrive continuously; show them as they come.
+    appState.frameScheduler().requestFrameIn(std::chrono::milliseconds(33));
+  } else if (!_statusMessage.empty()) {
     auto now = std::chrono::steady_clock::now();
     if (!_statusTime || std::chrono::duration_cast<std::chrono::seconds>(now - *_statusTime).count() < 3) {
       ImGui::SameLine();
       ImGui::TextUnformatted(_statusMessage.c_str());
+      if (_statusTime) {
+        appState.frameScheduler().requestFrameAt(*_statusTime + std::chrono::seconds(3));
+      }
     } else if (_statusTime) {
       _statusMessage.clear();
     }
@@ -469,6 +835,37 @@ void drawStatusBar(AppState &appState)
   ImGui::End();
 }
 
+void drawSpaceTime(AppState &appState)
+{
+  if (!_showSpaceTime) return;
+  ImGui::SetNextWindowSize(ImVec2(520, 420), ImGuiCond_FirstUseEver);
+  if (ImGui::Begin("Space-time diagram", &_showSpaceTime)) {
+    auto &diagram = appState.spaceTime();
+    if (diagram.isEmpty()) {
+      ImGui::TextUnformatted("Run or step the machine to record its tape.");
+    } else {
+      const int rows = diagram.rows();
+      ImGui::Text("%zu steps, %zu per row; cells %d to %d", diagram.steps(), diagram.stride(),
+        diagram.firstCell(), diagram.firstCell() + ui::SpaceTimeDiagram::Width - 1);
+      const ImVec2 avail = ImGui::GetContentRegionAvail();
+      const ImVec2 pos = ImGui::GetCursorScreenPos();
+      // Whole columns, rows stretched to fill the height; time runs downwards.
+      const float rowHeight = (std::min)(4.0f, avail.y / (std::max)(rows, 1));
+      const ImVec2 size(avail.x, rowHeight * rows);
+      ImGui::Image(diagram.texture(), size, ImVec2(0, 0), ImVec2(1, float(rows) / ui::SpaceTimeDiagram::Height));
+      if (ImGui::IsItemHovered() && size.x > 0 && size.y > 0) {
+        const ImVec2 mouse = ImGui::GetIO().MousePos;
+        const int column = std::clamp(static_cast<int>((mouse.x - pos.x) / size.x * ui::SpaceTimeDiagram::Width), 0, ui::SpaceTimeDiagram::Width - 1);
+        const int row = std::clamp(static_cast<int>((mouse.y - pos.y) / size.y * rows), 0, rows - 1);
+        const char c = diagram.symbolAt(row, column);
+        ImGui::SetTooltip("Step %zu, cell %d: '%s'%s", row * diagram.stride(), diagram.firstCell() + column,
+          c == core::Tape::Blank ? "_" : appState.tm().symbols().name(c).c_str(), diagram.headAt(row) == diagram.firstCell() + column ? " (head)" : "");
+      }
+    }
+  }
+  ImGui::End();
+}
+
 void drawCanvas(AppState &appState)
 {
   ImGuiIO &io = ImGui::GetIO();
@@ -484,10 +881,28 @@ void drawCanvas(AppState &appState)
   ImGui::BeginChild("ScrollableArea", ImVec2(0, 0), false, ImGuiWindowFlags_HorizontalScrollbar);
   appState.setCanvasOrigin(ImGui::GetCursorScreenPos());
   appState.setScrollXY({ ImGui::GetScrollX(), ImGui::GetScrollY() });
+  appState.setViewport({ ImGui::GetWindowPos().x, ImGui::GetWindowPos().y, ImGui::GetWindowSize().x, ImGui::GetWindowSize().y });
 
   ImVec2 mousePos = io.MousePos;
   const bool leftClicked = ImGui::IsMouseClicked(0); // 0 = left mouse button
 
+  // Ctrl+wheel zooms about the mouse, Ctrl+0 goes back to 100%.
+  if (ImGui::IsWindowHovered() && io.KeyCtrl) {
+    bool zoomed = false;
+    if (io.MouseWheel != 0) {
+      appState.zoomAt(appState.zoom() * std::pow(1.15f, io.MouseWheel), mousePos);
+      zoomed = true;
+    } else if (ImGui::IsKeyPressed(ImGuiKey_0)) {
+      const auto &vp = appState.viewport();
+      appState.zoomAt(1.0f, ImVec2(vp.x + vp.w * 0.5f, vp.y + vp.h * 0.5f));
+      zoomed = true;
+    }
+    if (zoomed) {
+      ImGui::SetScrollX(appState.scrollXY().x);
+      ImGui::SetScrollY(appState.scrollXY().y);
+    }
+  }
+
   if (leftClicked) {
     const bool inCanvas = topLeft.y < mousePos.y && mousePos.y < _canvasHeight;
     if (inCanvas) {
@@ -540,7 +955,9 @@ void drawCanvas(AppState &appState)
   handleToolbar(appState);
 
 
-  ImGui::Dummy(ImVec2(2000, 2000)); // Sets the scrollable area size
+  const ImVec2 extent = appState.canvasExtent();
+  const float zoom = appState.zoom();
+  ImGui::Dummy(ImVec2((std::max)(2000.0f, extent.x + 500.0f) * zoom, (std::max)(2000.0f, extent.y + 500.0f) * zoom)); // Sets the scrollable area size
   ImGui::EndChild();
 
   _canvasHeight = ImGui::GetWindowHeight();
@@ -671,6 +1088,7 @@ void drawInfoPanel(AppState &appState, const ImVec2 &fixedScreenPos) {
   currentY += 5; // Small gap
   drawTextLine(std::format("States: {}", appState.tm().states().size()));
   drawTextLine(std::format("Transitions: {}", appState.tm().transitions().size()));
+  drawTextLine(std::format("Zoom: {}%", static_cast<int>(appState.zoom() * 100.0f + 0.5f)));
   auto execState = appState.getExecutionState();
   std::string stateStr = std::format("Status: {}", core::executionStateToStr(execState));
   drawTextLine(stateStr);
@@ -679,6 +1097,9 @@ void drawInfoPanel(AppState &appState, const ImVec2 &fixedScreenPos) {
     if (st.isAccept()) drawTextLine("State: ACCEPTED", Colors::darkGreen);
     if (st.isReject()) drawTextLine("State: REJECTED", Colors::darkRed);
   }
+  if (execState == core::ExecutionState::BUDGET_EXCEEDED) {
+    drawTextLine(std::format("Budget exceeded: {}", core::budgetLimitToStr(appState.exceededLimit())), Colors::darkRed);
+  }
   if (execState != core::ExecutionState::STOPPED) {
     currentY += 5;
     drawTextLine("Execution Metrics", IM_COL32(0, 0, 0, 255));
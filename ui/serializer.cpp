@@ -1,6 +1,9 @@
 #include "ui/serializer.hpp"
+#include "ui/binaryformat.hpp"
 #include "ui/drawobject.hpp"
+#include "ui/journal.hpp"
 #include "model/turingmachine.hpp"
+#include "model/mappedfile.hpp"
 #include "app.hpp"
 
 #include <fstream>
@@ -9,6 +12,12 @@
 #include <iomanip>
 #include <sstream>
 #include <iostream>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+#include <optional>
+#include <atomic>
+#include <streambuf>
 
 #include <imgui.h>
 #include "ui/imfilebrowser.h"
@@ -32,108 +41,774 @@ namespace {
     }
   }
 
-  ui::TransitionDrawObject *findTransitionDrawObject(AppState &appState, const std::string &key) {
-    for (size_t j = 0; j < appState.nofDrawObjects(); j ++) {
-      auto obj = appState.getDrawObject(j);
-      if (auto transObj = obj->asTransition()) {
-        auto tk = transObj->getTransition().uniqueKey();
-        if (tk == key) {
-          return const_cast<ui::TransitionDrawObject *>(transObj);
-        }
-      }
+  // Per-transition ui data, detached from the draw objects it came from. On load,
+  // hasStyle and hasLabel say which parts the file had.
+  struct TransitionUi {
+    ui::TransitionStyle style;
+    bool hasStyle = false;
+    bool visible = true;
+    bool hasLabel = false;
+    bool labelManual = false;
+    ImVec2 labelOffset{ 0, 0 };
+  };
+
+  // Reads one "transitionStyles" entry, as TransitionDrawObject::fromJson() would.
+  void transitionStyleFromJson(TransitionUi &tu, const json &j) {
+    if (j.contains("style")) {
+      tu.style.fromJson(j["style"]);
+      tu.hasStyle = true;
+    }
+    tu.visible = j.value("visible", true);
+  }
+
+  // Reads one "transitionLabels" entry, as TransitionLabelDrawObject::fromJson() would.
+  void transitionLabelFromJson(TransitionUi &tu, const json &j) {
+    tu.hasLabel = true;
+    tu.labelManual = j.value("hasManualPosition", false);
+    if (j.contains("manualOffset")) {
+      tu.labelOffset = ImVec2{ j["manualOffset"].value("x", 0.0f), j["manualOffset"].value("y", 0.0f) };
     }
-    return nullptr;
   }
 
-  ui::TransitionLabelDrawObject *findTransitionLabelDrawObject(AppState &appState, const std::string &key) {
-    for (size_t j = 0; j < appState.nofDrawObjects(); j ++) {
-      auto obj = appState.getDrawObject(j);
-      if (auto labelObj = obj->asTransitionLabel(); labelObj && labelObj->transitionDrawObject()) {
-        auto tk = labelObj->transitionDrawObject()->getTransition().uniqueKey();
-        if (tk == key) {
-          return const_cast<ui::TransitionLabelDrawObject *>(labelObj);
+  void applyTransitionUi(ui::TransitionDrawObject &tr, const TransitionUi &tu) {
+    if (tu.hasStyle) tr.setTransitionStyle(tu.style);
+    tr.setVisible(tu.visible);
+    if (tu.hasLabel && tu.labelManual && !tr.getLabels().empty()) {
+      tr.getLabels().front()->setManualOffset(tu.labelOffset);
+    }
+  }
+
+  // Everything a save needs, copied out of AppState on the UI thread so encoding and
+  // writing can run on a worker while the user keeps editing.
+  struct SaveSnapshot {
+    core::TuringMachine tm;
+    AppState::Menu mode = AppState::Menu::SELECT;
+    std::string created;
+    std::vector<ImVec2> positions;           // canvas coordinates, in tm.states() order
+    std::vector<TransitionUi> transitions;   // in tm.transitions() order
+  };
+
+  // A machine read from disk but not yet attached to AppState. Workers fill one of
+  // these; applyLoaded() swaps it in on the UI thread in one go.
+  struct LoadedMachine {
+    core::TuringMachine tm;
+    std::optional<AppState::Menu> mode;
+    std::vector<std::pair<std::string, ImVec2>> positions;  // state name -> canvas position
+    std::unordered_map<std::string, TransitionUi> keyedUi;  // json files, by transition key
+    std::vector<TransitionUi> transitionUi;                 // binary files, in transition order
+  };
+
+  // Shared between a FileJob and its worker.
+  struct JobControl {
+    std::atomic<float> progress{ 0.0f };
+    std::atomic<bool> cancelled{ false };
+  };
+
+  // Thrown on the worker once cancellation has been requested.
+  struct JobCancelled {};
+
+  // Publishes progress and unwinds the job if it was cancelled. Jobs run synchronously
+  // pass a null control.
+  void checkpoint(JobControl *ctl, float progress) {
+    if (!ctl) return;
+    ctl->progress.store(progress, std::memory_order_relaxed);
+    if (ctl->cancelled.load(std::memory_order_relaxed)) throw JobCancelled{};
+  }
+
+  std::string currentTimestamp() {
+    auto now = std::chrono::system_clock::now();
+    auto time_t = std::chrono::system_clock::to_time_t(now);
+    std::stringstream ss;
+    ss << std::put_time(std::localtime(&time_t), "%Y%m%d_%H%M%S");
+    return ss.str();
+  }
+
+  SaveSnapshot takeSnapshot(const AppState &appState) {
+    SaveSnapshot s;
+    s.tm = appState.tm();
+    s.mode = appState.menu();
+    s.created = currentTimestamp();
+    const auto &states = s.tm.states();
+    s.positions.reserve(states.size());
+    for (const auto &st : states) {
+      s.positions.push_back(appState.screenToCanvas(appState.statePosition(st)));
+    }
+    // Draw objects may be ordered differently from the transitions.
+    std::unordered_map<uint32_t, const ui::TransitionDrawObject *> drawById;
+    drawById.reserve(s.tm.transitions().size());
+    appState.transitionPool().forEach([&](const ui::TransitionDrawObject &tr) {
+      drawById.emplace(tr.getTransition().id(), &tr);
+    });
+    s.transitions.reserve(s.tm.transitions().size());
+    for (const auto &tr : s.tm.transitions()) {
+      TransitionUi tu;
+      if (auto it = drawById.find(tr.id()); it != drawById.end()) {
+        tu.style = it->second->transitionStyle();
+        tu.visible = it->second->isVisible();
+        if (!it->second->getLabels().empty()) {
+          const auto *lb = it->second->getLabels().front();
+          tu.hasLabel = true;
+          tu.labelManual = lb->hasManualPosition();
+          tu.labelOffset = lb->manualOffset();
         }
       }
+      s.transitions.push_back(tu);
     }
-    return nullptr;
+    return s;
   }
 
-} // anonymous namespace
+  json serializeSnapshot(const SaveSnapshot &s, JobControl *ctl) {
+    json j;
+    j["version"] = "1.0";
+    j["created"] = s.created;
+    j["turingMachine"] = s.tm.toJson();
+    checkpoint(ctl, 0.1f);
+    j["tape"] = s.tm.tape().toJson();
+    checkpoint(ctl, 0.2f);
+    j["ui"] = json::object();
+    j["ui"]["mode"] = modeToString(s.mode);
+    auto &positions = j["ui"]["statePositions"] = json::object();
+    const auto &states = s.tm.states();
+    for (size_t i = 0; i < states.size(); i ++) {
+      positions[states[i].name()] = { {"x", s.positions[i].x}, {"y", s.positions[i].y} };
+    }
+    auto &styles = j["ui"]["transitionStyles"] = json::object();
+    auto &labels = j["ui"]["transitionLabels"] = json::object();
+    const auto &transitions = s.tm.transitions();
+    for (size_t i = 0; i < transitions.size(); i ++) {
+      if ((i & 0xffff) == 0) checkpoint(ctl, 0.2f + 0.2f * i / transitions.size());
+      const auto &tu = s.transitions[i];
+      const std::string key = transitions[i].uniqueKey();
+      styles[key] = ui::TransitionDrawObject::toJson(tu.style, tu.visible);
+      if (tu.hasLabel) {
+        labels[key] = ui::TransitionLabelDrawObject::toJson(tu.labelManual, tu.labelOffset);
+      }
+    }
+    return j;
+  }
 
-json AppSerializer::serialize(const AppState &appState)
-{
-  json j;
-  j["version"] = "1.0";
-  j["created"] = getCurrentTimestamp();
-  j["turingMachine"] = appState.tm().toJson();
-  j["tape"] = appState.tm().tape().toJson();
-  j["ui"] = json::object();
-  j["ui"]["mode"] = modeToString(appState.menu());
-  j["ui"]["statePositions"] = json::object();
-  for (const auto &state : appState.tm().states()) {
-    ImVec2 pos = appState.statePosition(state) + appState.scrollXY() - appState.canvasOrigin();
-    std::string name = state.name();
-    j["ui"]["statePositions"][name] = { {"x", pos.x}, {"y", pos.y} };
-  }
-  j["ui"]["transitionStyles"] = json::object();
-  j["ui"]["transitionLabels"] = json::object();
-  for (size_t i = 0; i < appState.nofDrawObjects(); i ++) {
-    auto obj = appState.getDrawObject(i);
-    if (auto tr = obj->asTransition()) {
-      std::string transKey = tr->getTransition().uniqueKey();
-      j["ui"]["transitionStyles"][transKey] = tr->toJson();
-    } else if (auto lb = obj->asTransitionLabel()) {
-      std::string transKey = lb->transitionDrawObject()->getTransition().uniqueKey();
-      j["ui"]["transitionLabels"][transKey] = lb->toJson();
-    }
-  }
-  return j;
-}
+  // Loads rebuild the whole model. Rather than journaling every object, the journal is
+  // detached while they run and re-based on a fresh snapshot afterwards.
+  class JournalPause {
+  public:
+    explicit JournalPause(AppState &appState) : appState_(appState), journal_(appState.journal()) {
+      appState_.setJournal(nullptr);
+    }
+    ~JournalPause() {
+      appState_.setJournal(journal_);
+      if (journal_) journal_->compact(appState_);
+    }
+  private:
+    AppState &appState_;
+    EditJournal *journal_;
+  };
 
-bool AppSerializer::deserialize(const json &j, AppState &appState)
-{
-  try {
+  // Replaces the whole application state with `m`. Runs on the UI thread.
+  void applyLoaded(LoadedMachine &&m, AppState &appState) {
+    JournalPause pause(appState);
     appState.reset();
+    appState.tm() = std::move(m.tm);
+    // Positions go in first so the rebuild only lays out states the file has none for.
+    for (const auto &[name, pos] : m.positions) {
+      if (auto state = appState.tm().findState(name)) {
+        appState.setStatePosition(*state, appState.canvasToScreen(pos));
+      }
+    }
+    appState.rebuildDrawObjectsFromTM();
+    if (!m.keyedUi.empty()) {
+      appState.transitionPool().forEach([&](ui::TransitionDrawObject &tr) {
+        if (auto it = m.keyedUi.find(tr.getTransition().uniqueKey()); it != m.keyedUi.end()) {
+          applyTransitionUi(tr, it->second);
+        }
+      });
+    }
+    if (!m.transitionUi.empty()) {
+      // rebuildDrawObjectsFromTM() just created the transition objects in transition order.
+      size_t k = 0;
+      appState.transitionPool().forEach([&](ui::TransitionDrawObject &tr) {
+        if (k < m.transitionUi.size()) applyTransitionUi(tr, m.transitionUi[k++]);
+      });
+    }
+    if (m.mode) appState.setMenu(*m.mode);
+    appState.tm().reset();
+  }
+
+  // SAX handler that feeds a saved file straight into a LoadedMachine. Only one
+  // record (a transition, a tape cell, a ui entry) is materialized as a json value at
+  // a time, so peak memory tracks the model rather than the size of the document.
+  class StreamingLoader : public nlohmann::json_sax<json> {
+  public:
+    explicit StreamingLoader(LoadedMachine &m) : m_(m) {}
+
+    bool null() override { return value(json(nullptr)); }
+    bool boolean(bool v) override { return value(json(v)); }
+    bool number_integer(number_integer_t v) override { return value(json(v)); }
+    bool number_unsigned(number_unsigned_t v) override { return value(json(v)); }
+    bool number_float(number_float_t v, const string_t &) override { return value(json(v)); }
+    bool string(string_t &v) override { return value(json(std::move(v))); }
+    bool binary(binary_t &v) override { return value(json::binary(std::move(v))); }
+
+    bool start_object(std::size_t) override { return startContainer(json::object(), false); }
+    bool start_array(std::size_t) override { return startContainer(json::array(), true); }
+    bool end_object() override { return endContainer(); }
+    bool end_array() override { return endContainer(); }
+
+    bool key(string_t &k) override {
+      if (!capture_.empty()) {
+        captureKey_ = k;
+      } else {
+        frames_.back().key = k;
+      }
+      return true;
+    }
+
+    bool parse_error(std::size_t, const std::string &, const nlohmann::detail::exception &ex) override {
+      error_ = ex.what();
+      return false;
+    }
+
+    const std::string &error() const { return error_; }
+
+  private:
+    enum class Record { NONE, TRANSITION, UNCONNECTED_STATE, SYMBOL, TAPE_CELL, TAPE_SEGMENT, TAPE_HEAD, UI_MODE, STATE_POSITION, TRANSITION_STYLE, TRANSITION_LABEL };
+
+    struct Frame {
+      bool array = false;
+      std::string key;
+    };
+
+    // Classifies the value about to start at the current position of frames_.
+    Record recordAt() const {
+      // frames_[0] is the document root object.
+      const size_t depth = frames_.size();
+      if (depth < 2 || frames_[0].array) return Record::NONE;
+      const auto &section = frames_[0].key;
+      const auto &field = frames_[1].key;
+      if (depth == 2) {
+        if (section == "tape" && field == "headPosition") return Record::TAPE_HEAD;
+        if (section == "ui" && field == "mode") return Record::UI_MODE;
+        return Record::NONE;
+      }
+      if (depth != 3) return Record::NONE;
+      const auto &inner = frames_[2];
+      if (section == "turingMachine" && inner.array) {
+        if (field == "transitions") return Record::TRANSITION;
+        if (field == "unconnectedStates") return Record::UNCONNECTED_STATE;
+      } else if (section == "turingMachine" && !inner.array) {
+        if (field == "symbols") return Record::SYMBOL;
+      } else if (section == "tape" && inner.array) {
+        if (field == "segments") return Record::TAPE_SEGMENT;
+        if (field == "cells") return Record::TAPE_CELL;
+      } else if (section == "ui" && !inner.array) {
+        if (field == "statePositions") return Record::STATE_POSITION;
+        if (field == "transitionStyles") return Record::TRANSITION_STYLE;
+        if (field == "transitionLabels") return Record::TRANSITION_LABEL;
+      }
+      return Record::NONE;
+    }
+
+    json *attach(json &&v) {
+      json &parent = *capture_.back();
+      if (parent.is_array()) {
+        parent.push_back(std::move(v));
+        return &parent.back();
+      }
+      json &slot = parent[captureKey_];
+      slot = std::move(v);
+      return &slot;
+    }
+
+    bool value(json &&v) {
+      if (!capture_.empty()) {
+        attach(std::move(v));
+        return true;
+      }
+      if (auto kind = recordAt(); kind != Record::NONE) {
+        record_ = kind;
+        recordKey_ = frames_.back().key;
+        dispatch(v);
+      }
+      return true;
+    }
+
+    bool startContainer(json &&v, bool array) {
+      if (!capture_.empty()) {
+        capture_.push_back(attach(std::move(v)));
+        return true;
+      }
+      if (auto kind = recordAt(); kind != Record::NONE) {
+        record_ = kind;
+        recordKey_ = frames_.back().key;
+        fragment_ = std::move(v);
+        capture_.push_back(&fragment_);
+        return true;
+      }
+      frames_.push_back(Frame{ array, {} });
+      return true;
+    }
+
+    bool endContainer() {
+      if (!capture_.empty()) {
+        capture_.pop_back();
+        if (capture_.empty()) {
+          dispatch(fragment_);
+          fragment_ = nullptr;
+        }
+        return true;
+      }
+      frames_.pop_back();
+      return true;
+    }
+
+    void dispatch(json &j) {
+      auto &tm = m_.tm;
+      switch (record_) {
+      case Record::TRANSITION: tm.addTransition(core::TuringMachine::transitionFromJson(j)); break;
+      case Record::UNCONNECTED_STATE: tm.addUnconnectedState(core::TuringMachine::stateFromJson(j)); break;
+      case Record::SYMBOL:
+        if (!tm.symbols().define(recordKey_, static_cast<char>(j.get<unsigned char>()))) {
+          throw std::runtime_error("symbol '" + recordKey_ + "' conflicts with another symbol");
+        }
+        break;
+      case Record::TAPE_CELL: tm.tape().cellFromJson(j); break;
+      case Record::TAPE_SEGMENT: tm.tape().segmentFromJson(j); break;
+      case Record::TAPE_HEAD: tm.tape().setHead(j.get<int>()); break;
+      case Record::UI_MODE: m_.mode = stringToMode(j.get<std::string>()); break;
+      case Record::STATE_POSITION: m_.positions.emplace_back(recordKey_, ImVec2{ j["x"], j["y"] }); break;
+      case Record::TRANSITION_STYLE: transitionStyleFromJson(m_.keyedUi[recordKey_], j); break;
+      case Record::TRANSITION_LABEL: transitionLabelFromJson(m_.keyedUi[recordKey_], j); break;
+      case Record::NONE: break;
+      }
+      record_ = Record::NONE;
+    }
+
+    LoadedMachine &m_;
+    std::vector<Frame> frames_;
+    std::vector<json *> capture_;
+    std::string captureKey_;
+    json fragment_;
+    Record record_ = Record::NONE;
+    std::string recordKey_;
+    std::string error_;
+  };
+
+  // Reads a file in large chunks for the json parser, publishing how far it got.
+  // Reports end of input once the job is cancelled.
+  class ProgressFileBuf : public std::streambuf {
+  public:
+    ProgressFileBuf(const std::string &path, JobControl *ctl) : file_(path, std::ios::binary), ctl_(ctl), buf_(size_t(1) << 16) {
+      std::error_code ec;
+      total_ = std::filesystem::file_size(path, ec);
+    }
+    bool isOpen() const { return file_.is_open(); }
+
+  protected:
+    int_type underflow() override {
+      if (ctl_ && ctl_->cancelled.load(std::memory_order_relaxed)) return traits_type::eof();
+      file_.read(buf_.data(), static_cast<std::streamsize>(buf_.size()));
+      const auto n = file_.gcount();
+      if (n <= 0) return traits_type::eof();
+      read_ += static_cast<uintmax_t>(n);
+      if (ctl_ && total_) ctl_->progress.store(float(read_) / float(total_), std::memory_order_relaxed);
+      setg(buf_.data(), buf_.data(), buf_.data() + n);
+      return traits_type::to_int_type(buf_[0]);
+    }
+
+  private:
+    std::ifstream file_;
+    JobControl *ctl_;
+    std::vector<char> buf_;
+    uintmax_t total_ = 0;
+    uintmax_t read_ = 0;
+  };
+
+  // Same as parseJson(), for a document that is already in memory.
+  LoadedMachine loadedFromJson(const json &j) {
+    LoadedMachine m;
     if (j.contains("turingMachine")) {
-      appState.tm().fromJson(j["turingMachine"]);
+      m.tm.fromJson(j["turingMachine"]);
     }
     if (j.contains("tape")) {
-      appState.tm().tape().fromJson(j["tape"]);
+      m.tm.tape().fromJson(j["tape"]);
     }
-    rebuildDrawObjects(appState);
     if (j.contains("ui")) {
       const auto &ui = j["ui"];
       if (ui.contains("mode")) {
-        appState.setMenu(stringToMode(ui["mode"]));
+        m.mode = stringToMode(ui["mode"]);
       }
       if (ui.contains("statePositions")) {
         for (const auto &[stateName, posJson] : ui["statePositions"].items()) {
-          for (const auto &state : appState.tm().states()) {
-            if (state.name() == stateName) {
-              ImVec2 pos{ posJson["x"], posJson["y"] };
-              appState.setStatePosition(state, pos - appState.scrollXY() + appState.canvasOrigin());
-              break;
-            }
-          }
+          m.positions.emplace_back(stateName, ImVec2{ posJson["x"], posJson["y"] });
         }
       }
       if (ui.contains("transitionStyles")) {
         for (const auto &[transKey, styleData] : ui["transitionStyles"].items()) {
-          if (auto transObj = findTransitionDrawObject(appState, transKey)) {
-            transObj->fromJson(styleData);
-          }
+          transitionStyleFromJson(m.keyedUi[transKey], styleData);
         }
       }
       if (ui.contains("transitionLabels")) {
         for (const auto &[transKey, labelData] : ui["transitionLabels"].items()) {
-          if (auto labelObj = findTransitionLabelDrawObject(appState, transKey)) {
-            labelObj->fromJson(labelData);
-          }
+          transitionLabelFromJson(m.keyedUi[transKey], labelData);
         }
       }
+    }
+    return m;
+  }
 
+  LoadedMachine parseJson(std::istream &in, JobControl *ctl) {
+    LoadedMachine m;
+    StreamingLoader loader(m);
+    if (!json::sax_parse(in, &loader)) {
+      checkpoint(ctl, 1.0f);
+      throw std::runtime_error(loader.error());
     }
-    appState.tm().reset();
+    return m;
+  }
+
+  // --- Binary format helpers ---
+
+  template <class T>
+  void appendPod(std::vector<char> &buf, const T &v) {
+    const char *p = reinterpret_cast<const char *>(&v);
+    buf.insert(buf.end(), p, p + sizeof(T));
+  }
+
+  void padTo(std::vector<char> &buf, size_t size) {
+    buf.resize(size, 0);
+  }
+
+  void appendVarint(std::string &out, uint64_t v) {
+    while (v >= 0x80) {
+      out.push_back(static_cast<char>((v & 0x7f) | 0x80));
+      v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+  }
+
+  uint64_t readVarint(const char *&p, const char *end) {
+    uint64_t v = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+      uint8_t b = static_cast<uint8_t>(*p++);
+      v |= uint64_t(b & 0x7f) << shift;
+      if (!(b & 0x80)) return v;
+    }
+    throw std::runtime_error("truncated run length in tape segment");
+  }
+
+  std::string rleEncode(const std::string &raw) {
+    std::string out;
+    for (size_t i = 0; i < raw.size();) {
+      size_t j = i + 1;
+      while (j < raw.size() && raw[j] == raw[i]) j++;
+      out.push_back(raw[i]);
+      appendVarint(out, j - i);
+      i = j;
+    }
+    return out;
+  }
+
+  // Non-blank cells separated by at most this many blanks share one segment.
+  constexpr int MaxSegmentGap = 16;
+
+  void appendTapeSegment(std::vector<char> &buf, int start, const std::string &raw) {
+    std::string rle = rleEncode(raw);
+    const bool useRle = rle.size() < raw.size();
+    const std::string &payload = useRle ? rle : raw;
+    binfmt::TapeSegment seg{};
+    seg.start = start;
+    seg.length = static_cast<uint32_t>(raw.size());
+    seg.encoding = useRle ? binfmt::TapeEncoding::RLE : binfmt::TapeEncoding::RAW;
+    seg.payloadSize = static_cast<uint32_t>(payload.size());
+    appendPod(buf, seg);
+    buf.insert(buf.end(), payload.begin(), payload.end());
+    padTo(buf, binfmt::align4(buf.size()));
+  }
+
+  void appendTapeSection(std::vector<char> &buf, const core::Tape &tape, uint32_t &segmentCount) {
+    segmentCount = 0;
+    tape.forEachSegment(MaxSegmentGap, [&](int start, const std::string &raw) {
+      appendTapeSegment(buf, start, raw);
+      segmentCount++;
+      });
+  }
+
+  std::vector<char> encodeBinary(const SaveSnapshot &s, JobControl *ctl) {
+    const auto &tm = s.tm;
+    const auto &states = tm.states();
+    binfmt::Header h{};
+    std::memcpy(h.magic, binfmt::Magic, sizeof(h.magic));
+    h.version = binfmt::Version;
+    h.stateCount = static_cast<uint32_t>(states.size());
+    h.transitionCount = static_cast<uint32_t>(tm.transitions().size());
+    h.headPosition = tm.tape().head();
+
+    std::vector<char> buf(sizeof(binfmt::Header), 0);
+    std::unordered_map<std::string, uint32_t> stateIndex;
+    stateIndex.reserve(states.size());
+
+    h.stringTableOffset = buf.size();
+    std::vector<binfmt::StateRecord> stateRecords;
+    stateRecords.reserve(states.size());
+    for (const auto &st : states) {
+      const std::string name = st.name();
+      binfmt::StateRecord rec{};
+      rec.nameOffset = static_cast<uint32_t>(buf.size() - h.stringTableOffset);
+      rec.nameLength = static_cast<uint32_t>(name.size());
+      rec.type = static_cast<uint8_t>(st.type());
+      buf.insert(buf.end(), name.begin(), name.end());
+      stateIndex.emplace(name, static_cast<uint32_t>(stateRecords.size()));
+      stateRecords.push_back(rec);
+    }
+    std::vector<binfmt::SymbolRecord> symbolRecords;
+    tm.symbols().forEachInterned([&](const std::string &name, char code) {
+      binfmt::SymbolRecord rec{};
+      rec.nameOffset = static_cast<uint32_t>(buf.size() - h.stringTableOffset);
+      rec.nameLength = static_cast<uint32_t>(name.size());
+      rec.code = static_cast<uint8_t>(code);
+      buf.insert(buf.end(), name.begin(), name.end());
+      symbolRecords.push_back(rec);
+      });
+    h.stringTableSize = buf.size() - h.stringTableOffset;
+    padTo(buf, binfmt::align8(buf.size()));
+
+    h.statesOffset = buf.size();
+    for (const auto &rec : stateRecords) appendPod(buf, rec);
+    padTo(buf, binfmt::align8(buf.size()));
+
+    h.symbolsOffset = buf.size();
+    h.symbolCount = static_cast<uint32_t>(symbolRecords.size());
+    for (const auto &rec : symbolRecords) appendPod(buf, rec);
+    padTo(buf, binfmt::align8(buf.size()));
+
+    h.transitionsOffset = buf.size();
+    checkpoint(ctl, 0.1f);
+    for (const auto &tr : tm.transitions()) {
+      binfmt::TransitionRecord rec{};
+      rec.from = stateIndex.at(tr.from().name());
+      rec.to = stateIndex.at(tr.to().name());
+      rec.readSymbol = static_cast<uint8_t>(tr.readSymbol());
+      rec.writeSymbol = static_cast<uint8_t>(tr.writeSymbol());
+      rec.direction = static_cast<uint8_t>(tr.direction());
+      appendPod(buf, rec);
+    }
+    padTo(buf, binfmt::align8(buf.size()));
+
+    h.unconnectedOffset = buf.size();
+    for (const auto &st : tm.unconnectedStates()) {
+      appendPod(buf, stateIndex.at(st.name()));
+      h.unconnectedCount++;
+    }
+    padTo(buf, binfmt::align8(buf.size()));
+
+    h.positionsOffset = buf.size();
+    for (const auto &pos : s.positions) {
+      appendPod(buf, binfmt::PositionRecord{ pos.x, pos.y });
+    }
+    padTo(buf, binfmt::align8(buf.size()));
+
+    checkpoint(ctl, 0.3f);
+    h.stylesOffset = buf.size();
+    for (const auto &tu : s.transitions) {
+      binfmt::StyleRecord rec{};
+      rec.arcHeight = tu.style.arcHeight;
+      rec.lineThickness = tu.style.lineThickness;
+      rec.arrowSize = tu.style.arrowSize;
+      rec.color = tu.style.color;
+      rec.textColor = tu.style.textColor;
+      rec.transitionIndex = tu.style.transitionIndex;
+      rec.labelOffsetX = tu.labelOffset.x;
+      rec.labelOffsetY = tu.labelOffset.y;
+      rec.visible = tu.visible ? 1 : 0;
+      rec.labelManual = tu.labelManual ? 1 : 0;
+      appendPod(buf, rec);
+    }
+    padTo(buf, binfmt::align8(buf.size()));
+
+    checkpoint(ctl, 0.4f);
+    h.tapeOffset = buf.size();
+    appendTapeSection(buf, tm.tape(), h.tapeSegmentCount);
+    h.tapeSize = buf.size() - h.tapeOffset;
+
+    std::memcpy(buf.data(), &h, sizeof(h));
+    return buf;
+  }
+
+  template <class T>
+  const T *sectionAt(const char *data, size_t size, uint64_t offset, uint64_t count) {
+    if (offset > size || count > (size - offset) / sizeof(T)) {
+      throw std::runtime_error("binary file section out of bounds");
+    }
+    return reinterpret_cast<const T *>(data + offset);
+  }
+
+  LoadedMachine decodeBinary(const char *data, size_t size, JobControl *ctl) {
+    if (size < binfmt::HeaderSizeV1) throw std::runtime_error("binary file too small");
+    binfmt::Header h{};
+    std::memcpy(&h, data, binfmt::HeaderSizeV1);
+    if (std::memcmp(h.magic, binfmt::Magic, sizeof(h.magic)) != 0) throw std::runtime_error("not a binary machine file");
+    if (h.version == 0 || h.version > binfmt::Version) throw std::runtime_error("unsupported binary file version " + std::to_string(h.version));
+    if (h.version >= 2) {
+      // Version 2 appended the symbol table fields to the header.
+      if (size < sizeof(h)) throw std::runtime_error("binary file too small");
+      std::memcpy(&h, data, sizeof(h));
+    }
+
+    const char *names = sectionAt<char>(data, size, h.stringTableOffset, h.stringTableSize);
+    const auto *stateRecs = sectionAt<binfmt::StateRecord>(data, size, h.statesOffset, h.stateCount);
+    const auto *transRecs = sectionAt<binfmt::TransitionRecord>(data, size, h.transitionsOffset, h.transitionCount);
+    const auto *unconnected = sectionAt<uint32_t>(data, size, h.unconnectedOffset, h.unconnectedCount);
+
+    std::vector<core::State> states;
+    states.reserve(h.stateCount);
+    for (uint32_t i = 0; i < h.stateCount; i ++) {
+      const auto &rec = stateRecs[i];
+      if (uint64_t(rec.nameOffset) + rec.nameLength > h.stringTableSize) throw std::runtime_error("state name out of bounds");
+      states.emplace_back(std::string(names + rec.nameOffset, rec.nameLength), static_cast<core::State::Type>(rec.type));
+    }
+    auto stateAt = [&](uint32_t i) -> const core::State & {
+      if (i >= states.size()) throw std::runtime_error("state index out of range");
+      return states[i];
+      };
+
+    LoadedMachine m;
+    auto &tm = m.tm;
+    if (h.symbolCount) {
+      const auto *symbolRecs = sectionAt<binfmt::SymbolRecord>(data, size, h.symbolsOffset, h.symbolCount);
+      for (uint32_t i = 0; i < h.symbolCount; i ++) {
+        const auto &rec = symbolRecs[i];
+        if (uint64_t(rec.nameOffset) + rec.nameLength > h.stringTableSize) throw std::runtime_error("symbol name out of bounds");
+        const std::string name(names + rec.nameOffset, rec.nameLength);
+        if (!tm.symbols().define(name, static_cast<char>(rec.code))) throw std::runtime_error("symbol '" + name + "' conflicts with another symbol");
+      }
+    }
+    for (uint32_t i = 0; i < h.unconnectedCount; i ++) {
+      tm.addUnconnectedState(stateAt(unconnected[i]));
+    }
+    for (uint32_t i = 0; i < h.transitionCount; i ++) {
+      if ((i & 0xffff) == 0) checkpoint(ctl, 0.5f * i / h.transitionCount);
+      const auto &rec = transRecs[i];
+      tm.addTransition(core::Transition(stateAt(rec.from), stateAt(rec.to),
+        static_cast<char>(rec.readSymbol), static_cast<char>(rec.writeSymbol), static_cast<core::Tape::Dir>(rec.direction)));
+    }
+
+    auto &tape = tm.tape();
+    const char *p = sectionAt<char>(data, size, h.tapeOffset, h.tapeSize);
+    const char *end = p + h.tapeSize;
+    std::string decoded;
+    const char *tapeBegin = p;
+    for (uint32_t s = 0; s < h.tapeSegmentCount; s ++) {
+      checkpoint(ctl, 0.5f + 0.5f * float(p - tapeBegin) / float((std::max)(h.tapeSize, uint64_t(1))));
+      if (end - p < static_cast<ptrdiff_t>(sizeof(binfmt::TapeSegment))) throw std::runtime_error("truncated tape segment");
+      binfmt::TapeSegment seg;
+      std::memcpy(&seg, p, sizeof(seg));
+      p += sizeof(seg);
+      if (static_cast<size_t>(end - p) < seg.payloadSize) throw std::runtime_error("truncated tape payload");
+      if (seg.encoding == binfmt::TapeEncoding::RAW) {
+        if (seg.payloadSize != seg.length) throw std::runtime_error("bad raw tape segment");
+        tape.writeRange(seg.start, p, seg.length);
+      } else {
+        decoded.clear();
+        decoded.reserve(seg.length);
+        const char *q = p, *qend = p + seg.payloadSize;
+        while (q < qend) {
+          char symbol = *q++;
+          uint64_t run = readVarint(q, qend);
+          if (decoded.size() + run > seg.length) throw std::runtime_error("bad RLE tape segment");
+          decoded.append(static_cast<size_t>(run), symbol);
+        }
+        tape.writeRange(seg.start, decoded.data(), decoded.size());
+      }
+      p += binfmt::align4(seg.payloadSize);
+      if (p > end) p = end;
+    }
+    tape.setHead(h.headPosition);
+
+    if (h.positionsOffset) {
+      const auto *pos = sectionAt<binfmt::PositionRecord>(data, size, h.positionsOffset, h.stateCount);
+      m.positions.reserve(h.stateCount);
+      for (uint32_t i = 0; i < h.stateCount; i ++) {
+        m.positions.emplace_back(states[i].name(), ImVec2{ pos[i].x, pos[i].y });
+      }
+    }
+    if (h.stylesOffset) {
+      const auto *styles = sectionAt<binfmt::StyleRecord>(data, size, h.stylesOffset, h.transitionCount);
+      m.transitionUi.reserve(h.transitionCount);
+      for (uint32_t i = 0; i < h.transitionCount; i ++) {
+        const auto &rec = styles[i];
+        TransitionUi tu;
+        tu.style.arcHeight = rec.arcHeight;
+        tu.style.lineThickness = rec.lineThickness;
+        tu.style.arrowSize = rec.arrowSize;
+        tu.style.color = rec.color;
+        tu.style.textColor = rec.textColor;
+        tu.style.transitionIndex = rec.transitionIndex;
+        tu.hasStyle = true;
+        tu.hasLabel = true;
+        tu.visible = rec.visible != 0;
+        tu.labelManual = rec.labelManual != 0;
+        tu.labelOffset = ImVec2{ rec.labelOffsetX, rec.labelOffsetY };
+        m.transitionUi.push_back(tu);
+      }
+    }
+    checkpoint(ctl, 1.0f);
+    return m;
+  }
+
+  // Writes next to `filepath` and renames over it once complete, so a failed or
+  // cancelled save never leaves a truncated file behind.
+  void writeWhole(const std::string &filepath, const char *data, size_t size, JobControl *ctl, float progressFrom) {
+    const std::string partPath = filepath + ".part";
+    try {
+      std::ofstream file(partPath, std::ios::binary);
+      if (!file) throw std::runtime_error("cannot open " + partPath);
+      constexpr size_t chunk = size_t(1) << 20;
+      for (size_t done = 0; done < size; done += chunk) {
+        checkpoint(ctl, progressFrom + (1.0f - progressFrom) * float(done) / float(size));
+        file.write(data + done, static_cast<std::streamsize>((std::min)(chunk, size - done)));
+      }
+      file.close();
+      if (!file) throw std::runtime_error("failed writing " + partPath);
+      std::filesystem::rename(partPath, filepath);
+    } catch (...) {
+      std::error_code ec;
+      std::filesystem::remove(partPath, ec);
+      throw;
+    }
+  }
+
+  void writeMachine(const SaveSnapshot &s, const std::string &filepath, JobControl *ctl) {
+    if (std::filesystem::path(filepath).extension() == binfmt::Extension) {
+      auto buf = encodeBinary(s, ctl);
+      writeWhole(filepath, buf.data(), buf.size(), ctl, 0.5f);
+    } else {
+      const std::string text = serializeSnapshot(s, ctl).dump(2);
+      writeWhole(filepath, text.data(), text.size(), ctl, 0.5f);
+    }
+  }
+
+  LoadedMachine readMachine(const std::string &filepath, JobControl *ctl) {
+    if (AppSerializer::isBinaryFile(filepath)) {
+      utils::MappedFile mf(filepath);
+      if (!mf.isOpen()) throw std::runtime_error("cannot map " + filepath);
+      return decodeBinary(mf.data(), mf.size(), ctl);
+    }
+    ProgressFileBuf buf(filepath, ctl);
+    if (!buf.isOpen()) throw std::runtime_error("cannot open " + filepath);
+    std::istream in(&buf);
+    return parseJson(in, ctl);
+  }
+
+} // anonymous namespace
+
+json AppSerializer::serialize(const AppState &appState)
+{
+  return serializeSnapshot(takeSnapshot(appState), nullptr);
+}
+
+bool AppSerializer::deserialize(const json &j, AppState &appState)
+{
+  try {
+    applyLoaded(loadedFromJson(j), appState);
     return true;
   } catch (const std::exception &e) {
     std::cerr << "Load error: " << e.what() << std::endl;
@@ -148,10 +823,7 @@ bool AppSerializer::saveToFile(const AppState &appState, const std::string &file
     filepath = "machine_" + getCurrentTimestamp() + ".json";
   }
   try {
-    json j = serialize(appState);
-    std::ofstream file(filepath);
-    file << j.dump(2);
-    file.close();
+    writeMachine(takeSnapshot(appState), filepath, nullptr);
     std::cout << "Saved to: " << filepath << std::endl;
     return true;
   } catch (const std::exception &e) {
@@ -175,28 +847,31 @@ bool AppSerializer::loadFromFile(AppState &appState, const std::string &path)
     return false;
   }
   try {
-    std::ifstream file(filepath);
-    json j;
-    file >> j;
-    bool success = deserialize(j, appState);
-    if (success) {
-      std::cout << "Loaded from: " << filepath << std::endl;
-    }
-    std::filesystem::path fsPath(filepath);
-    appState.setWindowTitle(fsPath.filename().string());
-    return success;
+    applyLoaded(readMachine(filepath, nullptr), appState);
+    std::cout << "Loaded from: " << filepath << std::endl;
+    appState.setWindowTitle(std::filesystem::path(filepath).filename().string());
+    return true;
   } catch (const std::exception &e) {
     std::cerr << "Load error: " << e.what() << std::endl;
     return false;
   }
 }
 
+bool AppSerializer::isBinaryFile(const std::string &filepath)
+{
+  char magic[sizeof(binfmt::Magic)] = {};
+  std::ifstream file(filepath, std::ios::binary);
+  file.read(magic, sizeof(magic));
+  return file.gcount() == sizeof(magic) && std::memcmp(magic, binfmt::Magic, sizeof(magic)) == 0;
+}
+
 std::vector<std::string> AppSerializer::getSavedFiles()
 {
   std::vector<std::string> files;
   try {
     for (const auto &entry : std::filesystem::directory_iterator(".")) {
-      if (entry.path().extension() == ".json" &&
+      const auto ext = entry.path().extension();
+      if ((ext == ".json" || ext == binfmt::Extension) &&
         entry.path().filename().string().find("machine_") == 0) {
         files.push_back(entry.path().filename().string());
       }
@@ -214,7 +889,7 @@ void AppSerializer::saveToFileWithDialog(const AppState &appState)
 {
   auto &dlg = AppState::fileBrowserSave();
   dlg.SetTitle("Save to file");
-  dlg.SetTypeFilters({ ".json", ".txt" });
+  dlg.SetTypeFilters({ ".json", binfmt::Extension, ".txt" });
   dlg.Open();
 }
 
@@ -222,7 +897,23 @@ void AppSerializer::loadFrFileWithDialog(const AppState &appState)
 {
   auto &dlg = AppState::fileBrowserOpen();
   dlg.SetTitle("Open file");
-  dlg.SetTypeFilters({ ".json", ".txt" });
+  dlg.SetTypeFilters({ ".json", binfmt::Extension, ".txt" });
+  dlg.Open();
+}
+
+void AppSerializer::importTapeWithDialog(const AppState &appState)
+{
+  auto &dlg = AppState::fileBrowserTapeImport();
+  dlg.SetTitle("Import tape at head");
+  dlg.SetTypeFilters({ ".*", ".bin", ".txt" });
+  dlg.Open();
+}
+
+void AppSerializer::exportTapeWithDialog(const AppState &appState)
+{
+  auto &dlg = AppState::fileBrowserTapeExport();
+  dlg.SetTitle("Export tape");
+  dlg.SetTypeFilters({ ".*", ".bin", ".txt" });
   dlg.Open();
 }
 
@@ -242,11 +933,7 @@ void AppSerializer::rebuildDrawObjects(AppState &appState)
 
 std::string AppSerializer::getCurrentTimestamp()
 {
-  auto now = std::chrono::system_clock::now();
-  auto time_t = std::chrono::system_clock::to_time_t(now);
-  std::stringstream ss;
-  ss << std::put_time(std::localtime(&time_t), "%Y%m%d_%H%M%S");
-  return ss.str();
+  return currentTimestamp();
 }
 
 std::string AppSerializer::findMostRecentFile()
@@ -254,3 +941,128 @@ std::string AppSerializer::findMostRecentFile()
   auto files = getSavedFiles();
   return files.empty() ? "" : files[0];
 }
+
+
+//------------------------------------------------------------------------------------------
+
+
+struct MachineSnapshot::Data {
+  SaveSnapshot snapshot;
+};
+
+MachineSnapshot::MachineSnapshot(const AppState &appState) : data_(new Data{ takeSnapshot(appState) })
+{
+}
+
+MachineSnapshot::~MachineSnapshot() = default;
+MachineSnapshot::MachineSnapshot(MachineSnapshot &&) noexcept = default;
+MachineSnapshot &MachineSnapshot::operator=(MachineSnapshot &&) noexcept = default;
+
+bool MachineSnapshot::write(const std::string &filename) const
+{
+  try {
+    writeMachine(data_->snapshot, filename, nullptr);
+    return true;
+  } catch (const std::exception &e) {
+    std::cerr << "Save error: " << e.what() << std::endl;
+    return false;
+  }
+}
+
+
+//------------------------------------------------------------------------------------------
+
+
+struct FileJob::Shared {
+  JobControl control;
+  std::atomic<bool> finished{ false };
+  bool ok = false;
+  bool cancelled = false;
+  std::optional<LoadedMachine> loaded;
+};
+
+FileJob::FileJob() = default;
+
+FileJob::~FileJob()
+{
+  cancel();
+  if (worker_.joinable()) worker_.join();
+}
+
+bool FileJob::startLoad(const std::string &filename)
+{
+  if (isRunning()) return false;
+  if (!std::filesystem::exists(filename)) {
+    std::cerr << "File not found: " << filename << std::endl;
+    return false;
+  }
+  kind_ = Kind::LOAD;
+  path_ = filename;
+  shared_ = std::make_shared<Shared>();
+  worker_ = std::thread([shared = shared_, filename]() {
+    try {
+      shared->loaded = readMachine(filename, &shared->control);
+      shared->ok = true;
+    } catch (const JobCancelled &) {
+      shared->cancelled = true;
+    } catch (const std::exception &e) {
+      std::cerr << "Load error: " << e.what() << std::endl;
+    }
+    shared->finished.store(true, std::memory_order_release);
+    });
+  return true;
+}
+
+bool FileJob::startSave(const AppState &appState, const std::string &filename)
+{
+  if (isRunning()) return false;
+  kind_ = Kind::SAVE;
+  path_ = filename;
+  shared_ = std::make_shared<Shared>();
+  worker_ = std::thread([shared = shared_, snapshot = takeSnapshot(appState), filename]() {
+    try {
+      writeMachine(snapshot, filename, &shared->control);
+      shared->ok = true;
+    } catch (const JobCancelled &) {
+      shared->cancelled = true;
+    } catch (const std::exception &e) {
+      std::cerr << "Save error: " << e.what() << std::endl;
+    }
+    shared->finished.store(true, std::memory_order_release);
+    });
+  return true;
+}
+
+void FileJob::cancel()
+{
+  if (shared_) shared_->control.cancelled.store(true, std::memory_order_relaxed);
+}
+
+float FileJob::progress() const
+{
+  return shared_ ? shared_->control.progress.load(std::memory_order_relaxed) : 0.0f;
+}
+
+std::optional<FileJob::Outcome> FileJob::poll(AppState &appState)
+{
+  if (!isRunning() || !shared_->finished.load(std::memory_order_acquire)) return std::nullopt;
+  worker_.join();
+  auto shared = std::move(shared_);
+  const Kind kind = kind_;
+  kind_ = Kind::NONE;
+  if (shared->cancelled) return Outcome::CANCELLED;
+  if (!shared->ok) return Outcome::FAILED;
+  if (kind == Kind::LOAD) {
+    try {
+      applyLoaded(std::move(*shared->loaded), appState);
+    } catch (const std::exception &e) {
+      std::cerr << "Load error: " << e.what() << std::endl;
+      return Outcome::FAILED;
+    }
+    std::cout << "Loaded from: " << path_ << std::endl;
+  } else {
+    std::cout << "Saved to: " << path_ << std::endl;
+  }
+  appState.setWindowTitle(std::filesystem::path(path_).filename().string());
+  return Outcome::SUCCEEDED;
+}
@@ -4,6 +4,9 @@
 #include <nlohmann/json.hpp>
 #include <string>
 #include <vector>
+#include <memory>
+#include <optional>
+#include <thread>
 
 class AppState;
 
@@ -21,12 +24,17 @@ public:
   static nlohmann::json serialize(const AppState &appState);
   // Load complete application state
   static bool deserialize(const nlohmann::json &j, AppState &appState);
+  // Both handle the packed, mmap-friendly format (see ui/binaryformat.hpp) as well as
+  // json; it is picked by extension on save and by magic bytes on load.
   static bool saveToFile(const AppState &appState, const std::string &filename = "");
   static bool loadFromFile(AppState &appState, const std::string &filename = "");
+  static bool isBinaryFile(const std::string &filename);
   static std::vector<std::string> getSavedFiles();
 
   static void saveToFileWithDialog(const AppState &appState);
   static void loadFrFileWithDialog(const AppState &appState);
+  static void importTapeWithDialog(const AppState &appState);
+  static void exportTapeWithDialog(const AppState &appState);
 
 private:
   static void rebuildDrawObjects(AppState &appState);
@@ -34,5 +42,58 @@ private:
   static std::string findMostRecentFile();
 };
 
+// Everything a save needs, copied out of AppState on the UI thread; write() may then
+// run on any thread.
+class MachineSnapshot {
+public:
+  explicit MachineSnapshot(const AppState &appState);
+  ~MachineSnapshot();
+  MachineSnapshot(MachineSnapshot &&) noexcept;
+  MachineSnapshot &operator=(MachineSnapshot &&) noexcept;
+
+  // Picks the format by extension, like AppSerializer::saveToFile().
+  bool write(const std::string &filename) const;
+
+private:
+  struct Data;
+  std::unique_ptr<Data> data_;
+};
+
+// Runs one save or load on a worker thread so large files never stall the frame.
+// The UI thread starts the job, polls it once per frame and may cancel it; a loaded
+// machine only replaces the current one from inside poll().
+class FileJob {
+public:
+  enum class Kind { NONE, LOAD, SAVE };
+  enum class Outcome { SUCCEEDED, FAILED, CANCELLED };
+
+  FileJob();
+  ~FileJob();
+  FileJob(const FileJob &) = delete;
+  FileJob &operator=(const FileJob &) = delete;
+
+  // Both return false if a job is already running. startSave() copies what it needs
+  // from appState before returning.
+  bool startLoad(const std::string &filename);
+  bool startSave(const AppState &appState, const std::string &filename);
+  void cancel();
+
+  bool isRunning() const { return kind_ != Kind::NONE; }
+  Kind kind() const { return kind_; }
+  const std::string &path() const { return path_; }
+  float progress() const;
+
+  // Returns the outcome once, after the worker finished; nullopt while it is running
+  // or when idle.
+  std::optional<Outcome> poll(AppState &appState);
+
+private:
+  struct Shared;
+  Kind kind_ = Kind::NONE;
+  std::string path_;
+  std::shared_ptr<Shared> shared_;
+  std::thread worker_;
+};
+
 
 #endif // _SERIALIZER_HPP_
\ No newline at end of file
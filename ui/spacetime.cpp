@@ -0,0 +1,102 @@
+#include "ui/spacetime.hpp"
+#include "model/turingmachine.hpp"
+#include "defs.hpp"
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cstring>
+
+
+void ui::SpaceTimeDiagram::reset(const core::Tape &tape)
+{
+  firstCell_ = tape.head() - Width / 2;
+  row_.resize(Width);
+  tape.readRange(firstCell_, row_.data(), row_.size());
+  cells_.assign(size_t(Width) * Height, core::Tape::Blank);
+  heads_.assign(Height, 0);
+  rowCount_ = 0;
+  uploadedRows_ = 0;
+  stride_ = 1;
+  steps_ = 0;
+  appendRow(tape.head());
+}
+
+void ui::SpaceTimeDiagram::record(const core::StepEvent &e)
+{
+  if (isEmpty()) return;
+  steps_++;
+  const int column = e.cell - firstCell_;
+  if (column >= 0 && column < Width) {
+    row_[column] = e.symbol;
+  }
+  if (steps_ % stride_ == 0) {
+    appendRow(e.head);
+  }
+}
+
+void ui::SpaceTimeDiagram::appendRow(int head)
+{
+  if (rowCount_ == Height) {
+    // Keep the even rows: row 2k was taken after 2k * stride steps, i.e. k rows of the
+    // doubled stride.
+    for (int r = 1; r < Height / 2; r++) {
+      std::memcpy(&cells_[size_t(r) * Width], &cells_[size_t(r) * 2 * Width], Width);
+      heads_[r] = heads_[r * 2];
+    }
+    rowCount_ = Height / 2;
+    uploadedRows_ = 0;
+    stride_ *= 2;
+    if (steps_ % stride_ != 0) return;
+  }
+  std::memcpy(&cells_[size_t(rowCount_) * Width], row_.data(), Width);
+  heads_[rowCount_] = head;
+  rowCount_++;
+}
+
+ImTextureID ui::SpaceTimeDiagram::texture()
+{
+  if (isEmpty()) return ImTextureID{};
+  GLint bound = 0;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound);
+  if (!texture_) {
+    glGenTextures(1, &texture_);
+    glBindTexture(GL_TEXTURE_2D, texture_);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, Width, Height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    uploadedRows_ = 0;
+  } else {
+    glBindTexture(GL_TEXTURE_2D, texture_);
+  }
+  if (uploadedRows_ < rowCount_) {
+    upload(uploadedRows_, rowCount_ - uploadedRows_);
+    uploadedRows_ = rowCount_;
+  }
+  glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(bound));
+  return (ImTextureID)(intptr_t)texture_;
+}
+
+void ui::SpaceTimeDiagram::releaseTexture()
+{
+  if (texture_) {
+    glDeleteTextures(1, &texture_);
+    texture_ = 0;
+  }
+}
+
+void ui::SpaceTimeDiagram::upload(int firstRow, int count)
+{
+  pixels_.resize(size_t(count) * Width);
+  uint32_t *px = pixels_.data();
+  for (int r = firstRow; r < firstRow + count; r++) {
+    const char *row = &cells_[size_t(r) * Width];
+    for (int x = 0; x < Width; x++) {
+      *px++ = row[x] == core::Tape::Blank ? Colors::white : utils::colorFromChar(row[x]);
+    }
+    const int head = heads_[r] - firstCell_;
+    if (head >= 0 && head < Width) {
+      px[head - Width] = Colors::red;
+    }
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, firstRow, Width, count, GL_RGBA, GL_UNSIGNED_BYTE, pixels_.data());
+}
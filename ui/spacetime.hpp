@@ -0,0 +1,65 @@
+#ifndef _SPACETIME_HPP_
+#define _SPACETIME_HPP_
+
+#include <imgui.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace core {
+  class Tape;
+  struct StepEvent;
+}
+
+namespace ui {
+
+  // Space-time diagram of a run: one row per step, one column per tape cell, coloured by
+  // symbol, with the head marked. Rows are built from the executor's step events rather
+  // than by re-reading the tape. Once the run outgrows the height, every other row is
+  // dropped and a row stands for twice as many steps, so memory stays at Width x Height
+  // however long the run is. Only rows added since the last frame are uploaded.
+  class SpaceTimeDiagram {
+  public:
+    static constexpr int Width = 1024;    // cells
+    static constexpr int Height = 1024;   // rows
+
+    SpaceTimeDiagram() = default;
+    SpaceTimeDiagram(const SpaceTimeDiagram &) = delete;
+    SpaceTimeDiagram &operator=(const SpaceTimeDiagram &) = delete;
+
+    // Starts over from the tape as it is now, with the columns centred on the head.
+    void reset(const core::Tape &tape);
+    void record(const core::StepEvent &e);
+
+    bool isEmpty() const { return rowCount_ == 0; }
+    int rows() const { return rowCount_; }
+    size_t steps() const { return steps_; }
+    size_t stride() const { return stride_; }        // steps per row
+    int firstCell() const { return firstCell_; }     // cell shown in column 0
+    char symbolAt(int row, int column) const { return cells_[size_t(row) * Width + column]; }
+    int headAt(int row) const { return heads_[row]; }
+
+    // Texture holding rows [0, rows()) at the top, with pending rows uploaded. Needs the
+    // GL context, as does releaseTexture(), which must run before the context goes away.
+    ImTextureID texture();
+    void releaseTexture();
+
+  private:
+    void appendRow(int head);
+    void upload(int firstRow, int count);
+
+    std::vector<char> row_;        // the tape under the columns, kept current by record()
+    std::vector<char> cells_;      // Height rows of Width symbols
+    std::vector<int> heads_;       // head cell per row
+    std::vector<uint32_t> pixels_; // upload scratch
+    int rowCount_ = 0;
+    int uploadedRows_ = 0;         // rows already in the texture
+    size_t stride_ = 1;
+    size_t steps_ = 0;
+    int firstCell_ = 0;
+    unsigned int texture_ = 0;
+  };
+
+}
+
+#endif // _SPACETIME_HPP_
@@ -0,0 +1,128 @@
+#include "ui/spatialindex.hpp"
+#include <algorithm>
+#include <cmath>
+
+
+ui::SpatialIndex::SpatialIndex(float cellSize) : cellSize_(cellSize)
+{
+}
+
+ui::SpatialIndex::Handle ui::SpatialIndex::add(DrawObject *obj)
+{
+  auto [it, added] = entries_.try_emplace(obj, Entry{ obj, nextOrder_++, {}, {} });
+  return &it->second;
+}
+
+void ui::SpatialIndex::remove(const DrawObject *obj)
+{
+  auto it = entries_.find(obj);
+  if (it == entries_.end()) return;
+  unlink(it->second);
+  entries_.erase(it);
+}
+
+void ui::SpatialIndex::clear()
+{
+  entries_.clear();
+  cells_.clear();
+  nextOrder_ = 0;
+}
+
+void ui::SpatialIndex::update(Handle h, const utils::Rect *boxes, size_t n)
+{
+  Entry &e = *h;
+  if (e.boxes.size() == n && std::equal(boxes, boxes + n, e.boxes.begin(), [](const utils::Rect &a, const utils::Rect &b) {
+    return a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h;
+  })) return;
+  e.boxes.assign(boxes, boxes + n);
+  std::vector<uint64_t> cells;
+  coveredCells(boxes, n, cells);
+  if (cells == e.cells) return;
+  unlink(e);
+  e.cells = std::move(cells);
+  for (auto key : e.cells) {
+    cells_[key].push_back(&e);
+  }
+}
+
+void ui::SpatialIndex::queryPoint(float x, float y, std::vector<DrawObject *> &out) const
+{
+  collect(utils::Rect{ x, y, 0, 0 }, [x, y](const utils::Rect &r) { return r.contains(x, y); }, out);
+}
+
+void ui::SpatialIndex::queryRect(const utils::Rect &rc, std::vector<DrawObject *> &out) const
+{
+  collect(rc, [&rc](const utils::Rect &r) { return rc.intersects(r); }, out);
+}
+
+int ui::SpatialIndex::cellCoord(float v) const
+{
+  return static_cast<int>(std::floor(v / cellSize_));
+}
+
+uint64_t ui::SpatialIndex::cellKey(int cx, int cy)
+{
+  return (uint64_t(uint32_t(cx)) << 32) | uint32_t(cy);
+}
+
+void ui::SpatialIndex::coveredCells(const utils::Rect *boxes, size_t n, std::vector<uint64_t> &cells) const
+{
+  for (size_t i = 0; i < n; i++) {
+    const auto &b = boxes[i];
+    const int x1 = cellCoord(b.x + b.w), y1 = cellCoord(b.y + b.h);
+    for (int cx = cellCoord(b.x); cx <= x1; cx++) {
+      for (int cy = cellCoord(b.y); cy <= y1; cy++) {
+        cells.push_back(cellKey(cx, cy));
+      }
+    }
+  }
+  std::sort(cells.begin(), cells.end());
+  cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+}
+
+void ui::SpatialIndex::unlink(Entry &e)
+{
+  for (auto key : e.cells) {
+    auto it = cells_.find(key);
+    if (it == cells_.end()) continue;
+    auto &bucket = it->second;
+    bucket.erase(std::remove(bucket.begin(), bucket.end(), &e), bucket.end());
+    if (bucket.empty()) cells_.erase(it);
+  }
+  e.cells.clear();
+}
+
+template <class Hit>
+void ui::SpatialIndex::collect(const utils::Rect &rc, Hit hit, std::vector<DrawObject *> &out) const
+{
+  std::vector<const Entry *> found;
+  auto test = [&](const Entry *e) {
+    for (const auto &b : e->boxes) {
+      if (hit(b)) {
+        found.push_back(e);
+        return;
+      }
+    }
+  };
+  const int x0 = cellCoord(rc.x), x1 = cellCoord(rc.x + rc.w);
+  const int y0 = cellCoord(rc.y), y1 = cellCoord(rc.y + rc.h);
+  const double span = (double(x1) - x0 + 1) * (double(y1) - y0 + 1);
+  if (span > double(cells_.size())) {
+    // A query wider than the populated area is cheaper as a plain scan.
+    for (const auto &[obj, e] : entries_) test(&e);
+  } else {
+    for (int cx = x0; cx <= x1; cx++) {
+      for (int cy = y0; cy <= y1; cy++) {
+        auto it = cells_.find(cellKey(cx, cy));
+        if (it == cells_.end()) continue;
+        for (const Entry *e : it->second) test(e);
+      }
+    }
+  }
+  // Objects spanning several cells show up once per cell.
+  std::sort(found.begin(), found.end(), [](const Entry *a, const Entry *b) { return a->order < b->order; });
+  found.erase(std::unique(found.begin(), found.end()), found.end());
+  out.clear();
+  out.reserve(found.size());
+  for (const Entry *e : found) out.push_back(e->obj);
+}
@@ -0,0 +1,61 @@
+#ifndef _SPATIALINDEX_HPP_
+#define _SPATIALINDEX_HPP_
+
+#include "defs.hpp"
+#include <cstdint>
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+namespace ui {
+
+  class DrawObject;
+
+  // Uniform hash grid over the canvas-space boxes of draw objects, so hit tests and
+  // rubber-band selection only look at objects near the query. An object may be indexed
+  // by several small boxes (a transition by its control points) so that a long edge does
+  // not land in every cell between its two states.
+  class SpatialIndex {
+    struct Entry;
+  public:
+    // Identifies an object's entry; valid until the object is removed or the index cleared.
+    using Handle = Entry *;
+
+    explicit SpatialIndex(float cellSize = 128.0f);
+
+    // Objects are indexed once added and given boxes; queries report them in add order.
+    Handle add(DrawObject *obj);
+    void remove(const DrawObject *obj);
+    void clear();
+    // Replaces the boxes of an entry. Returns early when they are unchanged and is cheap
+    // when the object stays within the same cells.
+    void update(Handle h, const utils::Rect *boxes, size_t n);
+    void update(Handle h, const utils::Rect &box) { update(h, &box, 1); }
+
+    // Objects with a box containing (x, y) / intersecting rc, in add order.
+    void queryPoint(float x, float y, std::vector<DrawObject *> &out) const;
+    void queryRect(const utils::Rect &rc, std::vector<DrawObject *> &out) const;
+
+  private:
+    struct Entry {
+      DrawObject *obj;
+      uint64_t order;
+      std::vector<utils::Rect> boxes;
+      std::vector<uint64_t> cells;  // sorted keys of the cells the boxes touch
+    };
+
+    int cellCoord(float v) const;
+    static uint64_t cellKey(int cx, int cy);
+    void coveredCells(const utils::Rect *boxes, size_t n, std::vector<uint64_t> &cells) const;
+    void unlink(Entry &e);
+    template <class Hit> void collect(const utils::Rect &rc, Hit hit, std::vector<DrawObject *> &out) const;
+
+    float cellSize_;
+    uint64_t nextOrder_ = 0;
+    std::unordered_map<const DrawObject *, Entry> entries_;
+    std::unordered_map<uint64_t, std::vector<Entry *>> cells_;
+  };
+
+}
+
+#endif // _SPATIALINDEX_HPP_